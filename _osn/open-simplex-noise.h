@@ -42,6 +42,12 @@ void open_simplex_noise_free(struct osn_context *ctx);
 int open_simplex_noise_init_perm(struct osn_context *ctx, int16_t p[], int nelements);
 double open_simplex_noise2(struct osn_context *ctx, double x, double y);
 double open_simplex_noise3(struct osn_context *ctx, double x, double y, double z);
+/* Batched 3D noise, see open-simplex-noise.c. Agrees with open_simplex_noise3() within: */
+#define OSN_BATCH_TOLERANCE (2.5e-4)
+void open_simplex_noise3_batch(struct osn_context *ctx, const double *x, const double *y, const double *z,
+		float *out, int n);
+void open_simplex_noise3_column(struct osn_context *ctx, double x, double y, double z, double ystep,
+		float *out, int n);
 double open_simplex_noise4(struct osn_context *ctx, double x, double y, double z, double w);
 
 #ifdef __cplusplus
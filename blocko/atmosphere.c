@@ -1,6 +1,7 @@
 #include "blocko.h"
 
 unsigned int sun_prog_id;
+GLint sun_uniforms[NR_UNIFORMS];
 GLuint sun_vbo, sun_vao;
 
 void sun_init()
@@ -13,6 +14,7 @@ void sun_init()
         glAttachShader(sun_prog_id, fragment);
         glLinkProgram(sun_prog_id);
         check_program_errors(sun_prog_id, "sun");
+        find_uniforms(sun_prog_id, sun_uniforms);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
@@ -60,13 +62,13 @@ void sun_draw(float *proj, float *view, float sun_pitch, unsigned int texid)
         glDepthMask(GL_FALSE);
         glUseProgram(sun_prog_id);
 
-        glUniformMatrix4fv(glGetUniformLocation(sun_prog_id, "proj"), 1, GL_FALSE, proj);
-        glUniformMatrix4fv(glGetUniformLocation(sun_prog_id, "view"), 1, GL_FALSE, view);
-        glUniformMatrix4fv(glGetUniformLocation(sun_prog_id, "model"), 1, GL_FALSE, model);
+        glUniformMatrix4fv(sun_uniforms[U_proj], 1, GL_FALSE, proj);
+        glUniformMatrix4fv(sun_uniforms[U_view], 1, GL_FALSE, view);
+        glUniformMatrix4fv(sun_uniforms[U_model], 1, GL_FALSE, model);
 
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, texid);
-        glUniform1i(glGetUniformLocation(sun_prog_id, "tex"), show_shadow_map ? 1 : 3);
+        glUniform1i(sun_uniforms[U_tex], show_shadow_map ? 1 : 3);
 
         glBindVertexArray(sun_vao);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
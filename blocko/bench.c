@@ -0,0 +1,1664 @@
+// Blocko benchmarks -- run headless, without a window or GL context
+//
+//   make bench-terrain    chunk generation speed, per-stage times and checksum
+//   make bench-mesh       plain against greedy meshing, point counts and coverage check
+//   make bench-lattice    coarse lattice noise against per voxel, speed and a diff image
+//   make bench-noise      batched 3D noise against the scalar path, speed and error
+//   make bench-cull       sections left by each culling stage, their cost and a visibility check
+//   make bench-lod        points at each level of detail, and for the rings around the start
+//   make bench-light      light steps/s spreading sunlight, then 100 lights placed in caves
+//   make bench-relight    blocks and lights placed and broken under a roof, light checked from scratch
+//   make bench-schedule   frames to spread new light a wave per frame against a time budget per frame
+//   make bench-corners    corner light from separate sun and glow volumes against the packed lightmap
+//   make bench-tiles      memory and T_() cost of sectioned tiles against the dense layout
+//   make bench-layout     light, corner light and meshing with the lightmap in columns, then in bricks
+//   make bench-save       chunks saved to region files, edited and saved again, then loaded back
+//
+// Or build with make bench and run ./bench <name> [args] yourself.
+
+#include "blocko.h"
+
+#include "cull.c"
+#include "light.c"
+#include "lod.c"
+#include "mesh.c"
+#include "terrain.c"
+#include "save.c"
+#include "tiles.c"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// test.c needs GL, and there's no test area here anyway
+int in_test_area(int x, int y, int z)
+{
+        return false;
+}
+
+// same allocations as startup() in main.c
+void bench_startup()
+{
+        open_simplex_noise(world_seed, &osn_context);
+        save_dir = "bench-saves"; // never load the game's saves, see bench_save()
+
+        lightmap = calloc(TILESD * TILESH * TILESW, sizeof *lightmap);
+
+        chunk_queue_lock = SDL_CreateMutex();
+        chunk_queue_changed = SDL_CreateCond();
+        mesh_queue_lock = SDL_CreateMutex();
+        mesh_queue_changed = SDL_CreateCond();
+        region_lock = SDL_CreateMutex();
+
+        if (!alloc_tiles() || !lightmap || !chunk_queue_lock || !chunk_queue_changed || !mesh_queue_lock ||
+                        !mesh_queue_changed || !region_lock || !alloc_light_queue(&sunq) || !alloc_light_queue(&gloq))
+        {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+        }
+}
+
+// FNV-1a, so runs with the same seed can be compared for bit-identical output
+unsigned checksum(unsigned char *p, size_t len)
+{
+        unsigned hash = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+                hash = (hash ^ p[i]) * 16777619u;
+        return hash;
+}
+
+// where a tile went in the dense layout tiles used to be kept in, a column at a time
+#define COLUMN_INDEX(x,y,z) (((size_t)(z) * TILESW + (x)) * TILESH + (y))
+
+void bench_dense_tiles(unsigned char *out)
+{
+        for (int z = 0; z < TILESD; z++) for (int x = 0; x < TILESW; x++) for (int y = 0; y < TILESH; y++)
+                out[COLUMN_INDEX(x, y, z)] = T_(x, y, z);
+}
+
+// checksum() of the tiles in the dense layout, so it's the same as it always was
+unsigned tiles_checksum()
+{
+        unsigned char *dense = malloc((size_t)TILESD * TILESH * TILESW);
+        if (!dense)
+        {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+        }
+
+        bench_dense_tiles(dense);
+        unsigned hash = checksum(dense, (size_t)TILESD * TILESH * TILESW);
+        free(dense);
+        return hash;
+}
+
+// checksum() of the sunlight or glow nibbles alone, a column at a time, the same
+// as it was of the separate sunlight and glolight volumes they used to be
+unsigned light_checksum(int glow)
+{
+        unsigned hash = 2166136261u;
+        int shift = glow ? 0 : 4;
+        for (int z = 0; z < TILESD; z++) for (int x = 0; x < TILESW; x++) for (int y = 0; y < TILESH; y++)
+                hash = (hash ^ ((LIGHT_(x, y, z) >> shift) & 15)) * 16777619u;
+        return hash;
+}
+
+// pack all the sections written as plain tiles, as compact_tiles() would over a
+// few frames in the game, and free the blocks they replace
+void bench_compact_tiles()
+{
+        compact_tiles(VAOS);
+        free_retired_tiles();
+}
+
+double bench_secs(unsigned long long counts)
+{
+        return (double)counts / SDL_GetPerformanceFrequency();
+}
+
+// generate chunks nearest-first around the player, who starts in the middle of the
+// world, on this thread or a pool of chunk builders like the game's
+unsigned long long bench_gen_chunks(int nr_chunks, int workers)
+{
+        unsigned long long start = SDL_GetPerformanceCounter();
+
+        if (workers)
+        {
+                chunk_workers = workers;
+
+                #pragma omp parallel num_threads(workers)
+                {
+                        while (nr_chunks_generated < nr_chunks && build_chunk(true))
+                                ;
+
+                        stop_chunk_builders = true;
+                        wake_chunk_builders();
+                }
+        }
+        else while (nr_chunks_generated < nr_chunks)
+                build_chunk(false);
+
+        unsigned long long gen_time = SDL_GetPerformanceCounter() - start;
+        bench_compact_tiles();
+        return gen_time;
+}
+
+// chunk generation speed, per-stage times and checksum
+int bench_terrain(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int workers = argc > 2 ? atoi(argv[2]) : 0;
+        CLAMP(nr_chunks, 1, VAOS);
+        CLAMP(workers, 0, TILE_READERS);
+
+        bench_startup();
+
+        unsigned long long start = SDL_GetPerformanceCounter();
+        create_hmap();
+        unsigned long long hmap_time = SDL_GetPerformanceCounter() - start;
+
+        unsigned long long gen_time = bench_gen_chunks(nr_chunks, workers);
+        nr_chunks = nr_chunks_generated; // workers may overshoot
+
+        stage_times[stage_] = 0;
+        for (int i = 0; i < stage_; i++)
+                stage_times[stage_] += stage_times[i];
+
+        if (workers)
+                printf("seed %u, %d chunks, %d chunk workers\n", world_seed, nr_chunks, workers);
+        else
+                printf("seed %u, %d chunks, %d omp threads\n", world_seed, nr_chunks, omp_threads);
+        printf("create_hmap   %8.3f s\n", bench_secs(hmap_time));
+        printf("gen_chunk     %8.3f s  %8.2f chunk/s\n",
+                        bench_secs(gen_time), nr_chunks / bench_secs(gen_time));
+        printf("\n%-14s %10s %10s %6s\n", "stage", "total s", "ms/chunk", "pct");
+        for (int i = 0; i <= stage_; i++)
+                printf("%-14s %10.3f %10.3f %5.1f%%\n",
+                                stagenamesprint[i],
+                                bench_secs(stage_times[i]),
+                                1000.0 * bench_secs(stage_times[i]) / nr_chunks,
+                                100.0 * stage_times[i] / stage_times[stage_]);
+        printf("\ntiles checksum %08x\n", tiles_checksum());
+
+        return 0;
+}
+
+// the parts of a packed point the mesh bench checks, whole blocks within the chunk
+// across and within the world going down
+struct mesh_point { int tex, orient, x, y, z, width, height; };
+
+struct mesh_point unpack_point(struct vbufv *p)
+{
+        return (struct mesh_point){
+                p->info & 255, p->info >> 8 & 7,
+                (int)(p->pos & 511) / 16 - 1, (int)(p->pos >> 18 & 4095) / 16 - 1, (int)(p->pos >> 9 & 511) / 16 - 1,
+                (p->info >> 11 & 15) + 1, (p->info >> 15 & 255) + 1,
+        };
+}
+
+// fold the n solid points mesh_section() just made and its water into hash, so
+// mesher changes can be checked to draw the same
+unsigned bench_mesh_sum(unsigned hash, size_t n)
+{
+        unsigned char *p[2] = { (unsigned char *)vbuf, (unsigned char *)wbuf };
+        size_t len[2] = { n * sizeof *vbuf, (w - wbuf) * sizeof *wbuf };
+
+        for (int k = 0; k < 2; k++) for (size_t i = 0; i < len[k]; i++)
+                hash = (hash ^ p[k][i]) * 16777619u;
+        return hash;
+}
+
+// plain and greedy meshes of the same chunks on a fixed seed, a section at a time,
+// checking that the greedy rectangles cover each block face the plain mesher draws
+// exactly once, and that the sections skipped as empty or buried have no faces
+int bench_mesh(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        while (step_sunlight())
+                ; // spread the light gen_chunk() left, like the game would
+
+        static short faces[CHUNKW][TILESH][CHUNKD][DOWN + 1]; // texture + 1 of each plain face
+        long long plain_points = 0, greedy_points = 0, mismatches = 0;
+        long long nr_sections = 0, nr_empty = 0, nr_buried = 0;
+        unsigned long long plain_time = 0, greedy_time = 0;
+        unsigned plain_sum = 2166136261u, greedy_sum = 2166136261u;
+
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                int xlo = cx * CHUNKW;
+                int zlo = cz * CHUNKD;
+                memset(faces, 0, sizeof faces);
+
+                for (int sy = 0; sy < SECTIONS; sy++)
+                {
+                        int ylo = sy * SECTH;
+                        int empty = section_empty(xlo, ylo, zlo);
+                        int buried = !empty && section_full(xlo, ylo, zlo) && section_buried(xlo, ylo, zlo);
+                        nr_sections++;
+                        nr_empty += empty;
+                        nr_buried += buried;
+
+                        greedy_meshing = false;
+                        unsigned long long start = SDL_GetPerformanceCounter();
+                        size_t n = mesh_section(xlo, ylo, zlo) - (w - wbuf); // solid faces come first
+                        plain_time += SDL_GetPerformanceCounter() - start;
+                        plain_points += n;
+                        plain_sum = bench_mesh_sum(plain_sum, n);
+
+                        for (size_t i = 0; i < n; i++)
+                        {
+                                struct mesh_point p = unpack_point(vbuf + i);
+                                if (p.y < ylo || p.y >= ylo + SECTH) mismatches++; // outside its section
+                                faces[p.x][p.y][p.z][p.orient] = p.tex + 1;
+                        }
+
+                        // there must be nothing to draw in a skipped section
+                        if (empty || buried)
+                        {
+                                show_light_values = true; // which turns skipping off
+                                if (mesh_section(xlo, ylo, zlo)) mismatches++;
+                                show_light_values = false;
+                        }
+
+                        greedy_meshing = true;
+                        start = SDL_GetPerformanceCounter();
+                        n = mesh_section(xlo, ylo, zlo) - (w - wbuf);
+                        greedy_time += SDL_GetPerformanceCounter() - start;
+                        greedy_points += n;
+                        greedy_sum = bench_mesh_sum(greedy_sum, n);
+
+                        for (size_t i = 0; i < n; i++)
+                        {
+                                struct mesh_point p = unpack_point(vbuf + i);
+                                int orient = p.orient;
+                                int flat = (orient == UP || orient == DOWN);
+                                int along_x = (orient != EAST && orient != WEST);
+
+                                for (int b = 0; b < p.height; b++) for (int a = 0; a < p.width; a++)
+                                {
+                                        int x = p.x + (along_x ? a : 0);
+                                        int y = p.y + (flat ? 0 : b);
+                                        int z = p.z + (flat ? b : along_x ? 0 : a);
+                                        if (y < ylo || y >= ylo + SECTH)
+                                        {
+                                                mismatches++; // outside its section
+                                                continue;
+                                        }
+                                        short *f = &faces[x][y][z][orient];
+
+                                        if (*f != p.tex + 1) mismatches++; // wrong texture, no face or covered twice
+                                        *f = -1;
+                                }
+                        }
+                }
+
+                for (int x = 0; x < CHUNKW; x++) for (int y = 0; y < TILESH; y++) for (int z = 0; z < CHUNKD; z++)
+                        for (int o = 0; o <= DOWN; o++)
+                                if (faces[x][y][z][o] > 0) mismatches++; // left uncovered
+        }
+
+        // once more through the mesh queue, as the mesh workers would, twice over to
+        // check each section is only queued once, then again once they're taken, as
+        // if edited while being meshed, to check only the newer meshes would go up
+        static struct qitem sections[VAOS * SECTIONS];
+        size_t nr_queued = 0, nr_ready = 0, nr_stale = 0;
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+                if (TAGEN_(cx, cz))
+                        for (int sy = 0; sy < SECTIONS; sy++)
+                                sections[nr_queued++] = (struct qitem){ cx, sy, cz };
+        request_meshes(sections, nr_queued);
+        request_meshes(sections, nr_queued);
+        while (build_mesh(false))
+                ;
+        request_meshes(sections, nr_queued);
+        while (build_mesh(false))
+                ;
+        for (struct chunk_mesh *m = take_ready_meshes(), *next; m; m = next)
+        {
+                next = m->next;
+                if (m->gen == mesh_job_gen[m->slot])
+                        nr_ready++;
+                else
+                        nr_stale++;
+                free(m);
+        }
+        if (nr_ready != nr_queued || nr_stale != nr_queued) mismatches++;
+
+        printf("seed %u, %d chunks\n", world_seed, nr_chunks);
+        printf("%-8s %12s %12s %10s\n", "", "points", "MB", "ms/chunk");
+        printf("%-8s %12lld %12.2f %10.3f\n", "plain", plain_points,
+                        plain_points * sizeof *vbuf / 1e6, 1000.0 * bench_secs(plain_time) / nr_chunks);
+        printf("%-8s %12lld %12.2f %10.3f\n", "greedy", greedy_points,
+                        greedy_points * sizeof *vbuf / 1e6, 1000.0 * bench_secs(greedy_time) / nr_chunks);
+        printf("%-8s %08x/%08x\n", "checksum", plain_sum, greedy_sum);
+        printf("\n%lld sections, %lld skipped as empty and %lld as solid and buried\n",
+                        nr_sections, nr_empty, nr_buried);
+        printf("%zu of %zu sections through the mesh queue, %zu older meshes left out\n",
+                        nr_ready, nr_queued, nr_stale);
+        printf("%.2fx fewer solid points, %lld mismatched faces: %s\n",
+                        (double)plain_points / greedy_points, mismatches, mismatches ? "FAIL" : "ok");
+
+        return mismatches ? 1 : 0;
+}
+
+// the same chunks with every octave sampled per voxel, and then with the octaves in
+// mask on the coarse lattice -- timing both and writing a top-down image of where
+// the tiles differ
+int bench_lattice(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int mask = argc > 2 ? atoi(argv[2]) : LAT_P300 | LAT_P90 | LAT_P91;
+        char *filename = argc > 3 ? argv[3] : "lattice.ppm";
+        CLAMP(nr_chunks, 1, VAOS);
+
+        // gen_chunk() keeps state between calls, so the per-voxel run happens in a
+        // child process that hands back its tiles and times through shared memory
+        size_t len = TILESD * TILESH * TILESW;
+        struct { unsigned long long gen, noise; } *base_time;
+        unsigned char *base = mmap(NULL, len + sizeof *base_time, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        base_time = (void *)(base + len);
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+                fprintf(stderr, "Could not fork\n");
+                return 1;
+        }
+
+        lattice_octaves = pid ? mask : 0;
+        if (pid)
+                waitpid(pid, NULL, 0);
+
+        bench_startup();
+        create_hmap();
+        unsigned long long gen_time = bench_gen_chunks(nr_chunks, 0);
+
+        if (!pid)
+        {
+                bench_dense_tiles(base);
+                base_time->gen = gen_time;
+                base_time->noise = stage_times[stage_column_noise];
+                exit(0);
+        }
+
+        unsigned char *tiles = malloc(len);
+        if (!tiles)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        bench_dense_tiles(tiles);
+
+        FILE *f = fopen(filename, "wb");
+        if (!f)
+        {
+                fprintf(stderr, "Could not open %s\n", filename);
+                return 1;
+        }
+
+        // one pixel per column: grey for surface height, red for how many tiles changed
+        long long changed = 0, columns_changed = 0;
+        fprintf(f, "P6\n%d %d\n255\n", TILESW, TILESD);
+        for (int z = 0; z < TILESD; z++) for (int x = 0; x < TILESW; x++)
+        {
+                unsigned char *a = base + ((size_t)z * TILESW + x) * TILESH;
+                unsigned char *b = tiles + ((size_t)z * TILESW + x) * TILESH;
+                int diffs = 0, surface = TILESH;
+                for (int y = 0; y < TILESH; y++)
+                {
+                        if (a[y] != b[y]) diffs++;
+                        if (surface == TILESH && b[y] && b[y] < LASTSOLID) surface = y;
+                }
+
+                changed += diffs;
+                columns_changed += !!diffs;
+
+                int grey = b[0] ? 255 - surface * 255 / TILESH : 0; // black if not generated
+                int red = diffs ? 128 + MIN(diffs * 8, 127) : grey;
+                fputc(red, f);
+                fputc(diffs ? grey / 3 : grey, f);
+                fputc(diffs ? grey / 3 : grey, f);
+        }
+        fclose(f);
+
+        long long generated = (long long)nr_chunks * CHUNKW * CHUNKD * TILESH;
+        printf("seed %u, %d chunks, lattice mask %d\n", world_seed, nr_chunks, mask);
+        printf("%-14s %10s %10s\n", "", "per voxel", "lattice");
+        printf("%-14s %10.3f %10.3f  %.2fx\n", "column_noise s",
+                        bench_secs(base_time->noise), bench_secs(stage_times[stage_column_noise]),
+                        (double)base_time->noise / stage_times[stage_column_noise]);
+        printf("%-14s %10.3f %10.3f  %.2fx\n", "gen_chunk s",
+                        bench_secs(base_time->gen), bench_secs(gen_time),
+                        (double)base_time->gen / gen_time);
+        printf("\ntiles changed  %lld (%.3f%%), in %lld columns\n",
+                        changed, 100.0 * changed / generated, columns_changed);
+        printf("wrote %s\n", filename);
+
+        return 0;
+}
+
+// open_simplex_noise3_batch() against open_simplex_noise3(), over chunk columns
+// at the scales gen_chunk() samples per voxel, failing if they disagree
+int bench_noise(int argc, char **argv)
+{
+        int scales[] = { 300, 90, 91, 42, 16, 9, 2 };
+        int nr_scales = sizeof scales / sizeof *scales;
+        int side = argc > 0 ? atoi(argv[0]) : 64;
+        CLAMP(side, 1, TILESW);
+
+        bench_startup();
+
+        double xs[TILESH], ys[TILESH], zs[TILESH];
+        float scalar[TILESH], batch[TILESH];
+        unsigned long long scalar_time = 0, batch_time = 0;
+        double worst = 0.0;
+        long long points = 0;
+
+        printf("%-6s %12s %10s %10s\n", "scale", "max error", "scalar ns", "batch ns");
+        for (int s = 0; s < nr_scales; s++)
+        {
+                double max_err = 0.0;
+                unsigned long long scale_scalar = scalar_time, scale_batch = batch_time;
+
+                for (int x = 512; x < 512 + side; x++) for (int z = 512; z < 512 + side; z++)
+                {
+                        // same rounding as the noise() macro
+                        for (int y = 0; y < TILESH; y++)
+                        {
+                                xs[y] = (float)(x+0.5)/(scales[s]);
+                                ys[y] = (float)(y+0.5)/(scales[s]);
+                                zs[y] = (float)(z+0.5)/(scales[s]);
+                        }
+
+                        unsigned long long start = SDL_GetPerformanceCounter();
+                        for (int y = 0; y < TILESH; y++)
+                                scalar[y] = open_simplex_noise3(osn_context, xs[y], ys[y], zs[y]);
+                        unsigned long long mid = SDL_GetPerformanceCounter();
+                        open_simplex_noise3_batch(osn_context, xs, ys, zs, batch, TILESH);
+                        unsigned long long end = SDL_GetPerformanceCounter();
+
+                        scalar_time += mid - start;
+                        batch_time += end - mid;
+                        points += TILESH;
+
+                        for (int y = 0; y < TILESH; y++)
+                                if (fabs(scalar[y] - batch[y]) > max_err)
+                                        max_err = fabs(scalar[y] - batch[y]);
+                }
+
+                printf("%-6d %12.3g %10.1f %10.1f\n", scales[s], max_err,
+                                1e9 * bench_secs(scalar_time - scale_scalar) / (side * side * TILESH),
+                                1e9 * bench_secs(batch_time - scale_batch) / (side * side * TILESH));
+                if (max_err > worst) worst = max_err;
+        }
+
+        printf("\nscalar %8.2f Mpoint/s\n", points / bench_secs(scalar_time) / 1000000.0);
+        printf("batch  %8.2f Mpoint/s (%.2fx)\n",
+                        points / bench_secs(batch_time) / 1000000.0,
+                        (double)scalar_time / batch_time);
+        printf("max error %.3g, tolerance %.3g: %s\n",
+                        worst, OSN_BATCH_TOLERANCE, worst <= OSN_BATCH_TOLERANCE ? "ok" : "FAIL");
+
+        return worst <= OSN_BATCH_TOLERANCE ? 0 : 1;
+}
+
+// whether anything opaque is in the way from a to b, in blocks, walking the tiles
+// the line passes through
+int bench_line_blocked(float *a, float *b)
+{
+        int cell[3], step[3];
+        float dir[3], next[3], delta[3];
+        float len = 0;
+
+        for (int d = 0; d < 3; d++)
+        {
+                dir[d] = b[d] - a[d];
+                len += dir[d] * dir[d];
+        }
+        len = sqrtf(len);
+
+        for (int d = 0; d < 3; d++)
+        {
+                dir[d] /= len;
+                cell[d] = (int)floorf(a[d]);
+                step[d] = dir[d] > 0 ? 1 : -1;
+                delta[d] = dir[d] ? fabsf(1.f / dir[d]) : INFINITY;
+                float edge = cell[d] + (dir[d] > 0 ? 1 : 0);
+                next[d] = dir[d] ? (edge - a[d]) / dir[d] : INFINITY;
+        }
+
+        int end[3] = { floorf(b[0]), floorf(b[1]), floorf(b[2]) };
+        while (cell[0] != end[0] || cell[1] != end[1] || cell[2] != end[2])
+        {
+                int d = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+                if (next[d] > len) break;
+                cell[d] += step[d];
+                next[d] += delta[d];
+
+                if (cell[1] < 0 || cell[1] >= TILESH) return false;
+                if ((cell[0] != end[0] || cell[1] != end[1] || cell[2] != end[2]) &&
+                                IS_OPAQUE(cell[0], cell[1], cell[2]))
+                        return true;
+        }
+
+        return false;
+}
+
+// frustum and occlusion culling of sections from a few spots around the start,
+// against a test of each chunk over the full height like before there was a
+// quadtree, checking no block face left out by occlusion culling can be seen from
+// the eye
+int bench_cull(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 256;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        static struct chunk_mesh *meshes[VAOS * SECTIONS];
+        greedy_meshing = false; // one point per block face, for the visibility check
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++) for (int sy = 0; sy < SECTIONS; sy++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                int xlo = cx * CHUNKW, ylo = sy * SECTH, zlo = cz * CHUNKD;
+                size_t len = mesh_section(xlo, ylo, zlo);
+                size_t solid_len = len - (w - wbuf);
+                VBOLEN_(cx, sy, cz) = len;
+                BOUNDS_(cx, sy, cz) = find_section_bounds(xlo, ylo, zlo, len);
+
+                int slot = SECT_(cx, sy, cz);
+                struct chunk_mesh *m = meshes[slot] = malloc(sizeof *m + solid_len * sizeof *vbuf);
+                *m = (struct chunk_mesh){ NULL, cx, sy, cz, 0, 0, slot, 0, solid_len, BOUNDS_(cx, sy, cz) };
+                memcpy(m->verts, vbuf, solid_len * sizeof *vbuf);
+        }
+
+        unsigned long long full_time = 0, quad_time = 0, occ_time = 0;
+        long long full_kept = 0, quad_kept = 0, occ_kept = 0, meshed = 0;
+        long long faces_checked = 0, faces_seen = 0, mismatches = 0;
+        int nr_views = 0;
+
+        int sx = STARTPX / BS;
+        int sz = STARTPZ / BS;
+        float heights[] = { 2, 30 };
+        float pitches[] = { -0.4f, 0.f, 0.4f };
+
+        for (int h = 0; h < 2; h++) for (int p = 0; p < 3; p++) for (int yaw8 = 0; yaw8 < 8; yaw8++)
+        {
+                float eye[3] = { sx + 0.5f, GNDH_(sx, sz) - heights[h], sz + 0.5f }; // in blocks
+                float near = 8.f;
+                float far = 99999.f;
+                float frustw = 4.5f * W / H;
+                float frusth = 4.5f;
+                float projM[] = {
+                        near/frustw,           0,                                  0,  0,
+                                  0, near/frusth,                                  0,  0,
+                                  0,           0,       -(far + near) / (far - near), -1,
+                                  0,           0, -(2.f * far * near) / (far - near),  0
+                };
+                float f[3], viewM[16], pvM[16];
+                lookit(viewM, f, eye[0] * BS, eye[1] * BS, eye[2] * BS, pitches[p], yaw8 * TAU / 8);
+                translate(viewM, -eye[0] * BS, -eye[1] * BS, -eye[2] * BS);
+                mat4_multiply(pvM, projM, viewM);
+                nr_views++;
+
+                // like before: every chunk, top to bottom of the world, all its sections
+                // drawn if it's in view
+                unsigned long long start = SDL_GetPerformanceCounter();
+                for (int i = 0; i < VAOW; i++) for (int j = 0; j < VAOD; j++)
+                {
+                        int nr_meshed = 0;
+                        for (int sy = 0; sy < SECTIONS; sy++)
+                                nr_meshed += !!VBOLEN_(i, sy, j);
+                        if (!nr_meshed) continue;
+                        meshed += nr_meshed;
+                        if (box_in_frustum(pvM, i * CHUNKW * BS, 0, j * CHUNKD * BS,
+                                        (i + 1) * CHUNKW * BS, TILESH * BS, (j + 1) * CHUNKD * BS) != OUTSIDE)
+                                full_kept += nr_meshed;
+                }
+                full_time += SDL_GetPerformanceCounter() - start;
+
+                static struct qitem sections[VAOS * SECTIONS], before[VAOS * SECTIONS];
+                int culled;
+                start = SDL_GetPerformanceCounter();
+                build_chunk_quadtree();
+                size_t len = frustum_cull(pvM, sections, &culled);
+                quad_time += SDL_GetPerformanceCounter() - start;
+                quad_kept += len;
+
+                // the quadtree has to agree with testing each section's own bounds
+                size_t own = 0;
+                for (int i = 0; i < VAOW; i++) for (int j = 0; j < VAOD; j++) for (int sy = 0; sy < SECTIONS; sy++)
+                {
+                        struct section_bounds *b = &BOUNDS_(i, sy, j);
+                        if (VBOLEN_(i, sy, j) && box_in_frustum(pvM, i * CHUNKW * BS, b->ylo * BS, j * CHUNKD * BS,
+                                        (i + 1) * CHUNKW * BS, b->yhi * BS, (j + 1) * CHUNKD * BS) != OUTSIDE)
+                                own++;
+                }
+                if (own != len) mismatches++;
+
+                memcpy(before, sections, len * sizeof *sections);
+                size_t before_len = len;
+                start = SDL_GetPerformanceCounter();
+                len = occlusion_cull(pvM, sections, len, &culled);
+                occ_time += SDL_GetPerformanceCounter() - start;
+                occ_kept += len;
+
+                // every face of the sections occlusion culling dropped has to be out
+                // of view or have something opaque in the way
+                for (size_t k = 0, kept = 0; k < before_len; k++)
+                {
+                        if (kept < len && !memcmp(sections + kept, before + k, sizeof *before))
+                        {
+                                kept++;
+                                continue;
+                        }
+
+                        struct chunk_mesh *m = meshes[SECT_(before[k].x, before[k].y, before[k].z)];
+                        for (size_t i = 0; i < m->len; i++)
+                        {
+                                struct mesh_point pt = unpack_point(m->verts + i);
+                                struct face_def *fd = face_defs + pt.orient;
+                                float target[3] = { // just off the middle of the face, on the open side
+                                        before[k].x * CHUNKW + pt.x + 0.5f + 0.51f * fd->dx,
+                                        pt.y + 0.5f + 0.51f * fd->dy,
+                                        before[k].z * CHUNKD + pt.z + 0.5f + 0.51f * fd->dz,
+                                };
+
+                                float v[4];
+                                mat4_f3_multiply(v, pvM, target[0] * BS, target[1] * BS, target[2] * BS);
+                                if (v[3] <= 0 || fabsf(v[0]) > v[3] || fabsf(v[1]) > v[3])
+                                        continue; // out of view anyway
+
+                                faces_checked++;
+                                if (!bench_line_blocked(eye, target))
+                                {
+                                        faces_seen++;
+                                        mismatches++;
+                                }
+                        }
+                }
+        }
+
+        printf("seed %u, %d chunks, %d views\n", world_seed, nr_chunks, nr_views);
+        printf("%-24s %12s %10s\n", "", "sections/view", "us/view");
+        printf("%-24s %12.1f\n", "meshed", (double)meshed / nr_views);
+        printf("%-24s %12.1f %10.1f\n", "frustum, full height", (double)full_kept / nr_views,
+                        1e6 * bench_secs(full_time) / nr_views);
+        printf("%-24s %12.1f %10.1f\n", "quadtree, tight y", (double)quad_kept / nr_views,
+                        1e6 * bench_secs(quad_time) / nr_views);
+        printf("%-24s %12.1f %10.1f\n", "then occlusion", (double)occ_kept / nr_views,
+                        1e6 * bench_secs(occ_time) / nr_views);
+        printf("\n%lld faces in view in occluded sections, %lld of them seen from the eye: %s\n",
+                        faces_checked, faces_seen, mismatches ? "FAIL" : "ok");
+
+        return mismatches ? 1 : 0;
+}
+
+// the same chunks meshed at each level of detail, and what picking levels by ring
+// around the start saves over drawing it all at full detail, checking the coarse
+// points all stay inside their sections
+int bench_lod(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 1024;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        while (step_sunlight())
+                ; // spread the light gen_chunk() left, like the game would
+
+        long long points[LODS] = { 0 }, picked_points = 0, mismatches = 0;
+        unsigned long long times[LODS] = { 0 };
+        int chunks_at[LODS] = { 0 };
+        int scx = STARTPX / BS / CHUNKW;
+        int scz = STARTPZ / BS / CHUNKD;
+
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                int picked = lod_for_ring(MAX(abs(cx - scx), abs(cz - scz)));
+                chunks_at[picked]++;
+
+                for (int lod = 0; lod < LODS; lod++) for (int sy = 0; sy < SECTIONS; sy++)
+                {
+                        int xlo = cx * CHUNKW, ylo = sy * SECTH, zlo = cz * CHUNKD;
+                        unsigned long long start = SDL_GetPerformanceCounter();
+                        size_t n = lod ? mesh_lod_section(xlo, ylo, zlo, lod) : mesh_section(xlo, ylo, zlo);
+                        times[lod] += SDL_GetPerformanceCounter() - start;
+                        points[lod] += n;
+                        if (lod == picked) picked_points += n;
+
+                        for (size_t i = 0; lod && i < n; i++)
+                        {
+                                struct mesh_point p = unpack_point(vbuf + i);
+                                int flat = (p.orient == UP || p.orient == DOWN);
+                                int along_x = (p.orient != EAST && p.orient != WEST);
+                                int wide_x = along_x ? p.width : 1;
+                                int wide_z = flat ? p.height : along_x ? 1 : p.width;
+                                int tall = flat ? 1 : p.height;
+
+                                if (p.x < 0 || p.x + wide_x > CHUNKW || p.z < 0 || p.z + wide_z > CHUNKD ||
+                                                p.y < ylo || p.y + tall > ylo + SECTH)
+                                        mismatches++;
+                        }
+                }
+        }
+
+        printf("seed %u, %d chunks, greedy meshing %s\n", world_seed, nr_chunks, greedy_meshing ? "on" : "off");
+        printf("%-8s %12s %12s %10s %14s\n", "", "points", "MB", "ms/chunk", "chunks by ring");
+        for (int lod = 0; lod < LODS; lod++)
+        {
+                char name[16];
+                snprintf(name, sizeof name, "%dx%s", 1 << lod, lod == LODS - 1 ? " hmap" : "");
+                printf("%-8s %12lld %12.2f %10.3f %14d\n", name, points[lod], points[lod] * sizeof *vbuf / 1e6,
+                                1000.0 * bench_secs(times[lod]) / nr_chunks, chunks_at[lod]);
+        }
+        printf("\nby ring from the start %lld points, %.2fx fewer than all at full detail\n",
+                        picked_points, (double)points[0] / picked_points);
+        printf("%lld coarse points outside their sections: %s\n", mismatches, mismatches ? "FAIL" : "ok");
+
+        return mismatches ? 1 : 0;
+}
+
+// spread light until the queue runs dry, counting the steps and blocks spread from
+unsigned long long bench_spread(int (*step)(), long long *steps, long long *spread)
+{
+        unsigned long long start = SDL_GetPerformanceCounter();
+        int n;
+        while ((n = step()))
+        {
+                (*steps)++;
+                *spread += n;
+        }
+        return SDL_GetPerformanceCounter() - start;
+}
+
+// how fast light spreads: first the sunlight new chunks leave, then glow from
+// lights placed in dark open blocks under the ground, with a checksum of both so
+// queue changes can be checked to light the world the same
+int bench_light(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int nr_lights = argc > 2 ? atoi(argv[2]) : 100;
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        long long sun_steps = 0, sun_spread = 0, glo_steps = 0, glo_spread = 0;
+        unsigned long long sun_time = bench_spread(step_sunlight, &sun_steps, &sun_spread);
+
+        // lights in caves: open, dark and under the ground, spread over the world
+        int placed = 0;
+        unsigned seed = SEED1(world_seed);
+        unsigned long long glo_time = 0;
+        for (int tries = 0; placed < nr_lights && tries < 10000000; tries++)
+        {
+                int x = RANDI(1, TILESW - 2);
+                int y = RANDI(1, TILESH - 2);
+                int z = RANDI(1, TILESD - 2);
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD) || T_(x, y, z) != OPEN || SUN_(x, y, z) || ABOVE_GROUND(x, y, z))
+                        continue;
+
+                SET_T_(x, y, z, LITE);
+                glo_enqueue(x, y, z, 15);
+                placed++;
+
+                if (placed % 10 == 0) // a few at a time, like a player would
+                        glo_time += bench_spread(step_glolight, &glo_steps, &glo_spread);
+        }
+        glo_time += bench_spread(step_glolight, &glo_steps, &glo_spread);
+
+        printf("seed %u, %d chunks, %d lights in caves\n", world_seed, nr_chunks, placed);
+        printf("%-8s %10s %12s %10s %12s %10s\n", "", "steps", "blocks", "s", "steps/s", "Mblock/s");
+        printf("%-8s %10lld %12lld %10.3f %12.1f %10.2f\n", "sun", sun_steps, sun_spread, bench_secs(sun_time),
+                        sun_steps / bench_secs(sun_time), sun_spread / bench_secs(sun_time) / 1e6);
+        printf("%-8s %10lld %12lld %10.3f %12.1f %10.2f\n", "glow", glo_steps, glo_spread, bench_secs(glo_time),
+                        glo_steps / bench_secs(glo_time), glo_spread / bench_secs(glo_time) / 1e6);
+        printf("\nsunlight checksum %08x, glow checksum %08x\n", light_checksum(false), light_checksum(true));
+
+        return 0;
+}
+
+// light the generated chunks from scratch: direct sunlight above the ground and
+// glow from every light, spread until done, which is where edits should end up
+void bench_light_from_scratch()
+{
+        long long steps = 0, spread = 0;
+
+        for (int x = 0; x < TILESW; x++) for (int z = 0; z < TILESD; z++)
+        {
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD))
+                        continue;
+
+                for (int y = 0; y < TILESH; y++)
+                        LIGHT_(x, y, z) = 0;
+        }
+
+        for (int x = 0; x < TILESW; x++) for (int z = 0; z < TILESD; z++)
+        {
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD))
+                        continue;
+
+                for (int y = 0; y < TILESH; y++)
+                {
+                        if (ABOVE_GROUND(x, y, z)) sun_enqueue(x, y, z, 15);
+                        if (T_(x, y, z) == LITE)   glo_enqueue(x, y, z, 15);
+                }
+        }
+
+        bench_spread(step_sunlight, &steps, &spread);
+        bench_spread(step_glolight, &steps, &spread);
+}
+
+// build a roof over a big lit area and make a mess under it, placing and breaking
+// blocks and lights a few at a time with light still spreading in between, like a
+// player would, then check the light the removals and relighting left against the
+// light worked out from scratch
+int bench_relight(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int nr_edits = argc > 2 ? atoi(argv[2]) : 2000;
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+        take_sun_seeds(SIZE_MAX);
+        bench_light_from_scratch();
+
+        // the roof, a few blocks over the highest ground under it
+        int roof_sz = 48;
+        int xlo = TILESW / 2 - roof_sz / 2;
+        int zlo = TILESD / 2 - roof_sz / 2;
+        int roof_y = TILESH;
+        for (int x = xlo; x < xlo + roof_sz; x++) for (int z = zlo; z < zlo + roof_sz; z++)
+                roof_y = MIN(roof_y, GNDH_(x, z));
+        roof_y = MAX(roof_y - 6, 1);
+
+        long long steps = 0, spread = 0;
+        unsigned long long start = SDL_GetPerformanceCounter();
+        int placed = 0, broken = 0, lights = 0;
+
+        for (int x = xlo; x < xlo + roof_sz; x++) for (int z = zlo; z < zlo + roof_sz; z++)
+        {
+                if (T_(x, roof_y, z) < OPEN)
+                        continue;
+
+                SET_T_(x, roof_y, z, HARD);
+                light_placed_block(x, roof_y, z);
+                if (++placed % 10 == 0)
+                {
+                        step_sunlight();
+                        step_glolight();
+                }
+        }
+
+        // under the roof, and sometimes holes in it
+        unsigned seed = SEED1(world_seed);
+        for (int i = 0; i < nr_edits; i++)
+        {
+                int x = RANDI(xlo, xlo + roof_sz - 1);
+                int z = RANDI(zlo, zlo + roof_sz - 1);
+                int y = RANDI(roof_y + 1, MIN(GNDH_(x, z) + 3, TILESH - 2));
+                int what = RANDF(0, 10); // the high bits, the low ones repeat too soon
+
+                if (what == 0)
+                        y = roof_y;
+
+                if (what < 5 && T_(x, y, z) < OPEN)
+                {
+                        int was = T_(x, y, z);
+                        SET_T_(x, y, z, OPEN);
+                        light_broken_block(x, y, z, was);
+                        broken++;
+                }
+                else if (what < 8 && T_(x, y, z) >= OPEN)
+                {
+                        SET_T_(x, y, z, HARD);
+                        light_placed_block(x, y, z);
+                        placed++;
+                }
+                else if (what == 8 && T_(x, y, z) == OPEN)
+                {
+                        SET_T_(x, y, z, LITE);
+                        glo_enqueue(x, y, z, 15);
+                        lights++;
+                }
+                else if (what == 9 && T_(x, y, z) == LITE)
+                {
+                        SET_T_(x, y, z, OPEN);
+                        light_broken_block(x, y, z, LITE);
+                        broken++;
+                }
+
+                if (i % 4 == 0)
+                {
+                        step_sunlight();
+                        step_glolight();
+                }
+        }
+
+        bench_spread(step_sunlight, &steps, &spread);
+        bench_spread(step_glolight, &steps, &spread);
+        unsigned long long edit_time = SDL_GetPerformanceCounter() - start;
+
+        // save what the edits left, then work it out from scratch and compare
+        size_t len = TILESD * TILESH * TILESW;
+        unsigned char *edited = malloc(len);
+        if (!edited)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        memcpy(edited, lightmap, len);
+
+        bench_light_from_scratch();
+
+        long long sun_wrong = 0, glo_wrong = 0, lit = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+                if ((edited[i] ^ lightmap[i]) & 0xf0) sun_wrong++;
+                if ((edited[i] ^ lightmap[i]) & 15) glo_wrong++;
+                if (lightmap[i]) lit++;
+        }
+
+        printf("seed %u, %d chunks, %dx%d roof at y=%d\n", world_seed, nr_chunks, roof_sz, roof_sz, roof_y);
+        printf("%d blocks placed, %d broken, %d lights, %.3f s with spreading\n",
+                        placed, broken, lights, bench_secs(edit_time));
+        printf("%lld lit blocks, %lld sunlight and %lld glow differ from scratch: %s\n",
+                        lit, sun_wrong, glo_wrong, sun_wrong || glo_wrong ? "FAIL" : "ok");
+
+        free(edited);
+        return sun_wrong || glo_wrong ? 1 : 0;
+}
+
+// corner light from separate sunlight and glow volumes, as it was before they
+// were packed into the lightmap
+void bench_split_corner(unsigned char *sun, unsigned char *glo, int x, int y, int z, float *s, float *g)
+{
+        int x_ = (x == 0) ? 0 : x - 1;
+        int y_ = (y == 0) ? 0 : y - 1;
+        int z_ = (z == 0) ? 0 : z - 1;
+        if (y == TILESH) y = TILESH - 1;
+
+        size_t sw = TILE_INDEX(x_, y_, z_), se = TILE_INDEX(x, y_, z_), nw = TILE_INDEX(x_, y_, z), ne = TILE_INDEX(x, y_, z);
+        size_t dy = TILE_INDEX(x, y, z) - ne;
+        *s = 0.008f * (sun[sw] + sun[sw+dy] + sun[se] + sun[se+dy] + sun[nw] + sun[nw+dy] + sun[ne] + sun[ne+dy]);
+        *g = 0.008f * (glo[sw] + glo[sw+dy] + glo[se] + glo[se+dy] + glo[nw] + glo[nw+dy] + glo[ne] + glo[ne+dy]);
+}
+
+// place lights in open blocks under the ground of the generated chunks, queued to
+// spread their glow, returning how many were placed
+int bench_cave_lights(int nr_lights)
+{
+        unsigned seed = SEED1(world_seed);
+        int placed = 0;
+
+        for (int tries = 0; placed < nr_lights && tries < 1000000; tries++)
+        {
+                int x = RANDI(1, TILESW - 2);
+                int y = RANDI(1, TILESH - 2);
+                int z = RANDI(1, TILESD - 2);
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD) || T_(x, y, z) != OPEN || ABOVE_GROUND(x, y, z))
+                        continue;
+
+                SET_T_(x, y, z, LITE);
+                glo_enqueue(x, y, z, 15);
+                placed++;
+        }
+
+        return placed;
+}
+
+// every block corner of the generated chunks lit from separate sunlight and glow
+// volumes and from the packed lightmap, as recalc_corner_lighting() used to go over
+// them, checking they agree, then the mesher over the same chunks
+int bench_corners(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        long long steps = 0, spread = 0;
+        bench_spread(step_sunlight, &steps, &spread);
+
+        // lights in caves, so there's some glow to add up too
+        bench_cave_lights(100);
+        bench_spread(step_glolight, &steps, &spread);
+
+        size_t len = TILESD * TILESH * TILESW;
+        unsigned char *sun = malloc(len);
+        unsigned char *glo = malloc(len);
+        if (!sun || !glo)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        for (size_t i = 0; i < len; i++)
+        {
+                sun[i] = lightmap[i] >> 4;
+                glo[i] = lightmap[i] & 15;
+        }
+
+        unsigned long long time[2] = { 0 };
+        double total[2][2] = {{ 0 }};
+        long long corners = 0;
+        for (int packed = 0; packed < 2; packed++)
+        {
+                unsigned long long start = SDL_GetPerformanceCounter();
+
+                for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+                {
+                        if (!TAGEN_(cx, cz)) continue;
+
+                        for (int x = cx * CHUNKW; x < (cx + 1) * CHUNKW; x++)
+                        for (int z = cz * CHUNKD; z < (cz + 1) * CHUNKD; z++)
+                        for (int y = 0; y < TILESH; y++)
+                        {
+                                float s, g;
+                                if (packed)
+                                        corner_light(x, y, z, &s, &g);
+                                else
+                                        bench_split_corner(sun, glo, x, y, z, &s, &g);
+                                total[packed][0] += s;
+                                total[packed][1] += g;
+                                corners += !packed;
+                        }
+                }
+
+                time[packed] = SDL_GetPerformanceCounter() - start;
+        }
+
+        unsigned long long mesh_time = SDL_GetPerformanceCounter();
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+                if (TAGEN_(cx, cz))
+                        for (int sy = 0; sy < SECTIONS; sy++)
+                                mesh_section(cx * CHUNKW, sy * SECTH, cz * CHUNKD);
+        mesh_time = SDL_GetPerformanceCounter() - mesh_time;
+
+        int same = total[0][0] == total[1][0] && total[0][1] == total[1][1];
+        printf("seed %u, %d chunks, %lld corners\n", world_seed, nr_chunks, corners);
+        printf("%-8s %10s %12s %12s\n", "", "MB", "ms/chunk", "Mcorner/s");
+        printf("%-8s %10.0f %12.3f %12.1f\n", "split", 2.0 * len / 1e6,
+                        1000.0 * bench_secs(time[0]) / nr_chunks, corners / bench_secs(time[0]) / 1e6);
+        printf("%-8s %10.0f %12.3f %12.1f\n", "packed", 1.0 * len / 1e6,
+                        1000.0 * bench_secs(time[1]) / nr_chunks, corners / bench_secs(time[1]) / 1e6);
+        printf("mesher %.3f ms/chunk\n", 1000.0 * bench_secs(mesh_time) / nr_chunks);
+        printf("\ncorner sums %.1f/%.1f sun, %.1f/%.1f glow: %s\n",
+                        total[0][0], total[1][0], total[0][1], total[1][1], same ? "ok" : "FAIL");
+
+        free(sun);
+        free(glo);
+        return same ? 0 : 1;
+}
+
+// whether any block within LIGHT_NEAR of ex, ez is still waiting to spread light
+int bench_near_queued(struct light_queue *q, int ex, int ez)
+{
+        for (int k = 0; k < 2; k++)
+        {
+                struct light_wave *w = q->wave + k;
+                for (size_t i = (k == (int)(q->gen & 1)) ? q->next : 0; i < w->len; i++)
+                        if (abs(w->items[i].x - ex) < LIGHT_NEAR && abs(w->items[i].z - ez) < LIGHT_NEAR)
+                                return true;
+        }
+        return false;
+}
+
+// spread a frame at a time till it's all spread, with whole waves like the game
+// used to or with step_light() on a budget, counting the frames, the frames till
+// the blocks near ex, ez were done, and the longest frame
+void bench_frames(int budget_us, int ex, int ez, int *frames, int *near_frames, double *worst_ms)
+{
+        *frames = 0;
+        *near_frames = 0;
+        *worst_ms = 0;
+
+        while (sun_seeds_len || light_queue_depth(&sunq) || light_queue_depth(&gloq))
+        {
+                unsigned long long start = SDL_GetPerformanceCounter();
+                if (budget_us)
+                {
+                        step_light(budget_us, ex, ez);
+                }
+                else
+                {
+                        step_sunlight();
+                        step_glolight();
+                }
+                *worst_ms = MAX(*worst_ms, 1000 * bench_secs(SDL_GetPerformanceCounter() - start));
+                (*frames)++;
+
+                if (!*near_frames && !bench_near_queued(&sunq, ex, ez) && !bench_near_queued(&gloq, ex, ez))
+                        *near_frames = *frames;
+        }
+}
+
+// light left by new chunks and lights placed near the camera, spread a wave per
+// frame against a time budget per frame, nearest first: frames taken, the longest,
+// and a check that both light the world the same
+int bench_schedule(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int budget_us = argc > 2 ? atoi(argv[2]) : LIGHT_BUDGET_US;
+        CLAMP(nr_chunks, 1, VAOS);
+        CLAMP(budget_us, 1, 1000000);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+
+        // save the light as the chunks left it, to spread it twice
+        size_t len = TILESD * TILESH * TILESW;
+        size_t nr_seeds = sun_seeds_len;
+        unsigned char *light = malloc(len);
+        struct qlight *seeds = malloc(nr_seeds * sizeof *seeds + 1);
+        if (!light || !seeds)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        memcpy(light, lightmap, len);
+        memcpy(seeds, sun_seeds, nr_seeds * sizeof *seeds);
+
+        // lights in caves around the camera
+        int ex = TILESW / 2;
+        int ez = TILESD / 2;
+        struct qitem lights[100];
+        int nr_lights = 0;
+        unsigned seed = SEED1(world_seed);
+        for (int tries = 0; nr_lights < 100 && tries < 1000000; tries++)
+        {
+                int x = RANDI(ex - LIGHT_NEAR + 1, ex + LIGHT_NEAR - 1);
+                int y = RANDI(1, TILESH - 2);
+                int z = RANDI(ez - LIGHT_NEAR + 1, ez + LIGHT_NEAR - 1);
+                if (T_(x, y, z) == OPEN && !ABOVE_GROUND(x, y, z))
+                {
+                        SET_T_(x, y, z, LITE);
+                        lights[nr_lights++] = QITEM(x, y, z);
+                }
+        }
+
+        int frames[2], near_frames[2];
+        double worst_ms[2];
+        unsigned sun_sum[2], glo_sum[2];
+        for (int run = 0; run < 2; run++)
+        {
+                memcpy(lightmap, light, len);
+                memcpy(sun_seeds, seeds, nr_seeds * sizeof *seeds);
+                sun_seeds_len = nr_seeds;
+                for (int i = 0; i < nr_lights; i++)
+                        glo_enqueue(lights[i].x, lights[i].y, lights[i].z, 15);
+
+                bench_frames(run ? budget_us : 0, ex, ez, frames + run, near_frames + run, worst_ms + run);
+                sun_sum[run] = light_checksum(false);
+                glo_sum[run] = light_checksum(true);
+        }
+
+        printf("seed %u, %d chunks, %zu sun seeds, %d lights near the camera\n",
+                        world_seed, nr_chunks, nr_seeds, nr_lights);
+        printf("%-16s %10s %10s %10s\n", "", "frames", "near done", "worst ms");
+        printf("%-16s %10d %10d %10.2f\n", "wave per frame", frames[0], near_frames[0], worst_ms[0]);
+        printf("%-16s %10d %10d %10.2f\n", "budget", frames[1], near_frames[1], worst_ms[1]);
+        printf("budget %dus/frame\n", budget_us);
+
+        int same = sun_sum[0] == sun_sum[1] && glo_sum[0] == glo_sum[1];
+        printf("\nsunlight %08x/%08x, glow %08x/%08x: %s\n",
+                        sun_sum[0], sun_sum[1], glo_sum[0], glo_sum[1], same ? "ok" : "FAIL");
+
+        free(light);
+        free(seeds);
+        return same ? 0 : 1;
+}
+
+// memory held by the sectioned tiles against the dense layout they replaced, and
+// the cost of T_() in each, walking the chunks column by column and at random
+int bench_tiles(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 256;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int lookups = argc > 2 ? atoi(argv[2]) : 1 << 24;
+        CLAMP(nr_chunks, 1, VAOS);
+        CLAMP(lookups, 1, 1 << 28);
+
+        bench_startup();
+        size_t table = tile_bytes(NULL); // slot table and shared blocks, before any chunk
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+        nr_chunks = nr_chunks_generated;
+
+        // again from plain tiles, to time packing them
+        for (int c = 0; c < VAOS; c++)
+                if (already_generated[c / VAOW][c % VAOW])
+                        for (int s = 0; s < SECTIONS; s++)
+                                loosen_section(c * SECTIONS + s);
+        free_retired_tiles();
+        unsigned long long compact_time = SDL_GetPerformanceCounter();
+        bench_compact_tiles();
+        compact_time = SDL_GetPerformanceCounter() - compact_time;
+
+        size_t len = (size_t)TILESD * TILESH * TILESW;
+        unsigned char *dense = malloc(len);
+        int *where = malloc(3 * (size_t)lookups * sizeof *where);
+        if (!dense || !where)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+        bench_dense_tiles(dense);
+
+        size_t counts[9];
+        size_t bytes = tile_bytes(counts);
+        double per_chunk = (double)(bytes - table) / nr_chunks;
+
+        // column by column through the generated chunks, as the mesher goes
+        unsigned long long seq_time[2];
+        unsigned sums[2] = { 0 };
+        long long seq_lookups = 0, differ = 0;
+        for (int packed = 0; packed < 2; packed++)
+        {
+                unsigned long long start = SDL_GetPerformanceCounter();
+
+                for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+                {
+                        if (!TAGEN_(cx, cz)) continue;
+
+                        for (int z = cz * CHUNKD; z < (cz + 1) * CHUNKD; z++)
+                        for (int x = cx * CHUNKW; x < (cx + 1) * CHUNKW; x++)
+                        for (int y = 0; y < TILESH; y++)
+                                sums[packed] = sums[packed] * 31 + (packed ? T_(x, y, z) : dense[COLUMN_INDEX(x, y, z)]);
+                }
+
+                seq_time[packed] = SDL_GetPerformanceCounter() - start;
+        }
+
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                for (int z = cz * CHUNKD; z < (cz + 1) * CHUNKD; z++)
+                for (int x = cx * CHUNKW; x < (cx + 1) * CHUNKW; x++)
+                for (int y = 0; y < TILESH; y++)
+                {
+                        differ += T_(x, y, z) != dense[COLUMN_INDEX(x, y, z)];
+                        seq_lookups++;
+                }
+        }
+
+        // and at random within them
+        unsigned seed = SEED1(world_seed);
+        for (int i = 0; i < lookups; )
+        {
+                int x = RANDI(0, TILESW - 1);
+                int z = RANDI(0, TILESD - 1);
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD)) continue;
+                where[3 * i + 0] = x;
+                where[3 * i + 1] = RANDI(0, TILESH - 1);
+                where[3 * i + 2] = z;
+                i++;
+        }
+
+        unsigned long long rand_time[2];
+        unsigned rand_sums[2] = { 0 };
+        for (int packed = 0; packed < 2; packed++)
+        {
+                unsigned long long start = SDL_GetPerformanceCounter();
+
+                for (int i = 0; i < lookups; i++)
+                {
+                        int x = where[3 * i + 0], y = where[3 * i + 1], z = where[3 * i + 2];
+                        rand_sums[packed] += packed ? T_(x, y, z) : dense[COLUMN_INDEX(x, y, z)];
+                }
+
+                rand_time[packed] = SDL_GetPerformanceCounter() - start;
+        }
+
+        int same = !differ && sums[0] == sums[1] && rand_sums[0] == rand_sums[1];
+        printf("seed %u, %d chunks\n", world_seed, nr_chunks);
+        printf("%-9s %10s %12s %10s %10s\n", "", "MB", "MB/world", "seq ns", "random ns");
+        printf("%-9s %10.1f %12.1f %10.2f %10.2f\n", "dense", len / 1e6, len / 1e6,
+                        1e9 * bench_secs(seq_time[0]) / seq_lookups, 1e9 * bench_secs(rand_time[0]) / lookups);
+        printf("%-9s %10.1f %12.1f %10.2f %10.2f\n", "sections", bytes / 1e6, (table + per_chunk * VAOS) / 1e6,
+                        1e9 * bench_secs(seq_time[1]) / seq_lookups, 1e9 * bench_secs(rand_time[1]) / lookups);
+        printf("\n%zu sections all one tile, %zu 1 bit, %zu 2 bit, %zu 4 bit, %zu plain\n",
+                        counts[0], counts[1], counts[2], counts[4], counts[8]);
+        printf("%.1f KB per chunk, %.1f KB of it slot table and shared blocks\n",
+                        per_chunk / 1e3, table / 1e3);
+        printf("compact_tiles %.3f ms/chunk\n", 1000.0 * bench_secs(compact_time) / nr_chunks);
+        printf("\n%lld tiles walked, %d looked up at random, %lld differ: %s\n",
+                        seq_lookups, lookups, differ, same ? "ok" : "FAIL");
+
+        free(dense);
+        free(where);
+        return same ? 0 : 1;
+}
+
+// spreading light, working out corner light and meshing, on whichever layout the
+// bench was built with, see MEM_INDEX() -- make bench-layout runs both
+int bench_layout(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        CLAMP(nr_chunks, 1, VAOS);
+
+        bench_startup();
+        create_hmap();
+        bench_gen_chunks(nr_chunks, 0);
+        nr_chunks = nr_chunks_generated;
+
+        long long steps = 0, spread = 0;
+        unsigned long long light_time = bench_spread(step_sunlight, &steps, &spread);
+        int lights = bench_cave_lights(100);
+        light_time += bench_spread(step_glolight, &steps, &spread);
+
+        long long corners = 0;
+        double total[2] = { 0 };
+        unsigned long long corner_time = SDL_GetPerformanceCounter();
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                for (int x = cx * CHUNKW; x < (cx + 1) * CHUNKW; x++)
+                for (int z = cz * CHUNKD; z < (cz + 1) * CHUNKD; z++)
+                for (int y = 0; y < TILESH; y++)
+                {
+                        float s, g;
+                        corner_light(x, y, z, &s, &g);
+                        total[0] += s;
+                        total[1] += g;
+                        corners++;
+                }
+        }
+        corner_time = SDL_GetPerformanceCounter() - corner_time;
+
+        long long points = 0;
+        unsigned mesh_sum = 2166136261u;
+        unsigned long long mesh_time = 0;
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                for (int sy = 0; sy < SECTIONS; sy++)
+                {
+                        unsigned long long start = SDL_GetPerformanceCounter();
+                        size_t n = mesh_section(cx * CHUNKW, sy * SECTH, cz * CHUNKD) - (w - wbuf);
+                        mesh_time += SDL_GetPerformanceCounter() - start;
+                        mesh_sum = bench_mesh_sum(mesh_sum, n);
+                        points += n + (w - wbuf);
+                }
+        }
+
+#ifdef BRICKS
+        printf("bricks of %dx%dx%d, ", CHUNKW, SECTH, CHUNKD);
+#else
+        printf("columns, ");
+#endif
+        printf("seed %u, %d chunks, %d lights in caves\n", world_seed, nr_chunks, lights);
+        printf("%-8s %12s %10s %12s\n", "", "", "ms/chunk", "M/s");
+        printf("%-8s %12lld %10.3f %12.2f\n", "light", spread,
+                        1000.0 * bench_secs(light_time) / nr_chunks, spread / bench_secs(light_time) / 1e6);
+        printf("%-8s %12lld %10.3f %12.2f\n", "corners", corners,
+                        1000.0 * bench_secs(corner_time) / nr_chunks, corners / bench_secs(corner_time) / 1e6);
+        printf("%-8s %12lld %10.3f %12.2f\n", "mesh", points,
+                        1000.0 * bench_secs(mesh_time) / nr_chunks, points / bench_secs(mesh_time) / 1e6);
+        printf("\nsunlight checksum %08x, glow checksum %08x, corner sums %.1f/%.1f, mesh checksum %08x\n",
+                        light_checksum(false), light_checksum(true), total[0], total[1], mesh_sum);
+
+        return 0;
+}
+
+// checksum() of the generated chunks as save_chunk() is given them
+unsigned saved_checksum()
+{
+        static unsigned char raw[CHUNK_BYTES];
+        unsigned hash = 2166136261u;
+
+        for (int cx = 0; cx < VAOW; cx++) for (int cz = 0; cz < VAOD; cz++)
+        {
+                if (!TAGEN_(cx, cz)) continue;
+
+                gather_chunk(cx, cz, raw);
+                for (size_t i = 0; i < CHUNK_BYTES; i++)
+                        hash = (hash ^ raw[i]) * 16777619u;
+        }
+
+        return hash;
+}
+
+// the region files of this seed, removed if remove_them, returning how many bytes
+// they were, and in live how many of those the headers and chunks take up
+long bench_region_files(int remove_them, long *live)
+{
+        char path[300];
+        unsigned char head[REGION_HEAD];
+        long bytes = 0;
+
+        if (live)
+                *live = 0;
+
+        for (int rx = 0; rx < VAOW / SAVE_REGION; rx++) for (int rz = 0; rz < VAOD / SAVE_REGION; rz++)
+        {
+                region_path(path, sizeof path, rx * SAVE_REGION, rz * SAVE_REGION, false);
+                FILE *f = fopen(path, "rb");
+                if (!f) continue;
+                if (live && fread(head, REGION_HEAD, 1, f) == 1)
+                {
+                        *live += REGION_HEAD;
+                        for (int i = 0; i < SAVE_REGION * SAVE_REGION; i++)
+                                *live += get_u32(head + 12 + i * 8);
+                }
+                if (!fseek(f, 0, SEEK_END))
+                        bytes += ftell(f);
+                fclose(f);
+                if (remove_them)
+                        remove(path);
+        }
+
+        if (remove_them)
+        {
+                snprintf(path, sizeof path, "%s/%u", save_dir, world_seed);
+                remove(path);
+                remove(save_dir);
+        }
+
+        return bytes;
+}
+
+// break and place blocks at random in the generated chunks, as the player would
+void bench_edits(int nr_edits, unsigned seed)
+{
+        for (int done = 0, tries = 0; done < nr_edits && tries < 1000000; tries++)
+        {
+                int x = RANDI(1, TILESW - 2);
+                int y = RANDI(1, TILESH - 2);
+                int z = RANDI(1, TILESD - 2);
+                if (!TAGEN_(x / CHUNKW, z / CHUNKD))
+                        continue;
+
+                int t = T_(x, y, z);
+                if (t == OPEN)
+                {
+                        SET_T_(x, y, z, HARD);
+                        light_placed_block(x, y, z);
+                }
+                else if (t < LASTSOLID)
+                {
+                        SET_T_(x, y, z, OPEN);
+                        light_broken_block(x, y, z, t);
+                }
+                else
+                {
+                        continue;
+                }
+
+                mark_unsaved(x, z);
+                done++;
+        }
+}
+
+// chunks generated, lit with lights placed in caves, and saved, then edited and
+// saved again a few rounds over, so chunks grow and move within their region files.
+// Then the same chunks loaded back by the chunk builder instead, checking they come
+// back as last saved
+int bench_save(int argc, char **argv)
+{
+        int nr_chunks = argc > 0 ? atoi(argv[0]) : 64;
+        if (argc > 1) world_seed = strtoul(argv[1], NULL, 10);
+        int rounds = argc > 2 ? atoi(argv[2]) : 10;
+        CLAMP(nr_chunks, 1, VAOS);
+
+        // the world has to start over empty to load it, so saving happens in a child
+        // process that hands back its times, bytes and checksum through shared memory
+        struct {
+                unsigned long long hmap, gen, save;
+                long bytes, edited_bytes, live_bytes;
+                int chunks, resaved, failures;
+                unsigned hash;
+        } *saved;
+        saved = mmap(NULL, sizeof *saved, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (saved == MAP_FAILED)
+        {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+                fprintf(stderr, "Could not fork\n");
+                return 1;
+        }
+
+        if (!pid)
+        {
+                bench_startup();
+                bench_region_files(true, NULL); // from an earlier run
+
+                unsigned long long start = SDL_GetPerformanceCounter();
+                create_hmap();
+                saved->hmap = SDL_GetPerformanceCounter() - start;
+                saved->gen = bench_gen_chunks(nr_chunks, 0);
+                saved->chunks = nr_chunks_generated;
+
+                bench_cave_lights(100);
+                while (step_light(1000000, 0, 0))
+                        ;
+
+                start = SDL_GetPerformanceCounter();
+                save_chunks(VAOS);
+                saved->save = SDL_GetPerformanceCounter() - start;
+                saved->bytes = bench_region_files(false, NULL);
+
+                for (int r = 0; r < rounds; r++)
+                {
+                        bench_edits(200, SEED2(r, 1));
+                        while (step_light(1000000, 0, 0))
+                                ;
+                        saved->resaved += save_chunks(VAOS);
+                }
+
+                saved->failures = save_failures;
+                saved->edited_bytes = bench_region_files(false, &saved->live_bytes);
+                saved->hash = saved_checksum();
+                exit(0);
+        }
+
+        waitpid(pid, NULL, 0);
+
+        // no create_hmap(), the chunk builder only makes it if a chunk isn't saved
+        bench_startup();
+        unsigned long long load_time = bench_gen_chunks(nr_chunks, 0);
+        unsigned hash = saved_checksum();
+        int ok = saved->chunks && !saved->failures && nr_chunks_loaded == saved->chunks && hash == saved->hash;
+        bench_region_files(true, NULL);
+
+        printf("seed %u, %d chunks saved, %d loaded, %d could not be saved\n",
+                        world_seed, saved->chunks, nr_chunks_loaded, saved->failures);
+        printf("%-12s %10s\n", "", "ms/chunk");
+        printf("%-12s %10.3f  + %.3f s create_hmap\n", "generate",
+                        1000.0 * bench_secs(saved->gen) / saved->chunks, bench_secs(saved->hmap));
+        printf("%-12s %10.3f\n", "save", 1000.0 * bench_secs(saved->save) / saved->chunks);
+        printf("%-12s %10.3f  %.1fx faster, create_hmap %s\n", "load",
+                        1000.0 * bench_secs(load_time) / nr_chunks_generated,
+                        (double)saved->gen / load_time * nr_chunks_generated / saved->chunks,
+                        hmap_created ? "still made" : "skipped");
+        printf("\n%.1fk a chunk on disk, %.1fk raw (%.1fx)\n",
+                        saved->bytes / 1000.0 / saved->chunks, CHUNK_BYTES / 1000.0,
+                        (double)CHUNK_BYTES * saved->chunks / saved->bytes);
+        printf("%d rounds of edits, %d chunks saved again, %.1fk on disk, %.1f%% of it slack\n",
+                        rounds, saved->resaved, saved->edited_bytes / 1000.0,
+                        100.0 * (saved->edited_bytes - saved->live_bytes) / saved->edited_bytes);
+        printf("checksum %08x/%08x: %s\n", saved->hash, hash, ok ? "ok" : "FAILED");
+
+        return !ok;
+}
+
+int main(int argc, char **argv)
+{
+        char *name = argc > 1 ? argv[1] : "";
+
+        if (!strcmp(name, "terrain")) return bench_terrain(argc - 2, argv + 2);
+        if (!strcmp(name, "mesh"))    return bench_mesh(argc - 2, argv + 2);
+        if (!strcmp(name, "lattice")) return bench_lattice(argc - 2, argv + 2);
+        if (!strcmp(name, "noise"))   return bench_noise(argc - 2, argv + 2);
+        if (!strcmp(name, "cull"))    return bench_cull(argc - 2, argv + 2);
+        if (!strcmp(name, "lod"))     return bench_lod(argc - 2, argv + 2);
+        if (!strcmp(name, "light"))   return bench_light(argc - 2, argv + 2);
+        if (!strcmp(name, "relight")) return bench_relight(argc - 2, argv + 2);
+        if (!strcmp(name, "schedule")) return bench_schedule(argc - 2, argv + 2);
+        if (!strcmp(name, "corners")) return bench_corners(argc - 2, argv + 2);
+        if (!strcmp(name, "tiles"))   return bench_tiles(argc - 2, argv + 2);
+        if (!strcmp(name, "layout"))  return bench_layout(argc - 2, argv + 2);
+        if (!strcmp(name, "save"))    return bench_save(argc - 2, argv + 2);
+
+        fprintf(stderr, "usage: %s terrain [chunks] [seed] [workers]\n"
+                        "       %s mesh [chunks] [seed]\n"
+                        "       %s lattice [chunks] [seed] [mask] [out.ppm]\n"
+                        "       %s noise [side]\n"
+                        "       %s cull [chunks] [seed]\n"
+                        "       %s lod [chunks] [seed]\n"
+                        "       %s light [chunks] [seed] [lights]\n"
+                        "       %s relight [chunks] [seed] [edits]\n"
+                        "       %s schedule [chunks] [seed] [budget_us]\n"
+                        "       %s corners [chunks] [seed]\n"
+                        "       %s tiles [chunks] [seed] [lookups]\n"
+                        "       %s layout [chunks] [seed]\n"
+                        "       %s save [chunks] [seed] [rounds]\n",
+                        argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                        argv[0]);
+        return 1;
+}
@@ -4,6 +4,8 @@
         #include <omp.h>
 #else
         #define omp_get_num_threads() 0
+        #define omp_get_num_procs() 1
+        #define omp_get_thread_num() 0
         #define omp_set_nested(n)
 #endif
 
@@ -11,19 +13,70 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
-#define GL3_PROTOTYPES 1
 
-#ifdef __APPLE__
-#include <OpenGL/gl3.h>
+#ifdef _WIN32
+        #include <direct.h>
+        #define MKDIR(path) _mkdir(path)
 #else
-#include <GL/glew.h>
+        #include <sys/stat.h>
+        #define MKDIR(path) mkdir(path, 0755)
 #endif
 
-#define SDL_DISABLE_IMMINTRIN_H
-#include <SDL.h>
-#define STBI_NO_SIMD
-#define STB_IMAGE_IMPLEMENTATION
-#include "../_stb/stb_image.h"
+#ifdef _MSC_VER
+        #include <intrin.h> // _InterlockedCompareExchange8()
+#endif
+
+#ifndef HEADLESS
+        #define GL3_PROTOTYPES 1
+
+        #ifdef __APPLE__
+        #include <OpenGL/gl3.h>
+        #else
+        #include <GL/glew.h>
+        #endif
+
+        #define SDL_DISABLE_IMMINTRIN_H
+        #include <SDL.h>
+        #define STBI_NO_SIMD
+        #define STB_IMAGE_IMPLEMENTATION
+        #include "../_stb/stb_image.h"
+#else // no window, no GL -- just enough to run terrain and light code in bench.c
+        #include <unistd.h>
+        typedef unsigned int GLuint;
+        typedef int GLint;
+        typedef struct __GLsync *GLsync;
+        typedef int SDL_Event;
+        typedef struct SDL_Window SDL_Window;
+        unsigned long long SDL_GetPerformanceCounter()
+        {
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        }
+        unsigned long long SDL_GetPerformanceFrequency() { return 1000000000ull; }
+        unsigned SDL_GetTicks() { return SDL_GetPerformanceCounter() / 1000000ull; }
+        void SDL_Delay(unsigned ms) { usleep(ms * 1000); }
+
+        #include <pthread.h>
+        typedef pthread_mutex_t SDL_mutex;
+        typedef pthread_cond_t SDL_cond;
+        SDL_mutex *SDL_CreateMutex()
+        {
+                SDL_mutex *m = malloc(sizeof *m);
+                if (m) pthread_mutex_init(m, NULL);
+                return m;
+        }
+        SDL_cond *SDL_CreateCond()
+        {
+                SDL_cond *c = malloc(sizeof *c);
+                if (c) pthread_cond_init(c, NULL);
+                return c;
+        }
+        int SDL_LockMutex(SDL_mutex *m) { return pthread_mutex_lock(m); }
+        int SDL_UnlockMutex(SDL_mutex *m) { return pthread_mutex_unlock(m); }
+        int SDL_CondWait(SDL_cond *c, SDL_mutex *m) { return pthread_cond_wait(c, m); }
+        int SDL_CondBroadcast(SDL_cond *c) { return pthread_cond_broadcast(c); }
+#endif
 
 #include "../_osn/open-simplex-noise.c"
 struct osn_context *osn_context;
@@ -62,6 +115,8 @@ struct osn_context *osn_context;
 #define H 1000                     // ^
 #define CHUNKW 16                  // chunk size (vao size)
 #define CHUNKD 16                  // ^
+#define SECTH 16                   // chunks are meshed and culled in sections this high
+#define SECTIONS (TILESH/SECTH)    // sections per chunk
 #define CHUNKW2 (CHUNKW/2)
 #define CHUNKD2 (CHUNKD/2)
 #define VAOW 64                    // how many VAOs wide
@@ -96,11 +151,14 @@ struct osn_context *osn_context;
 #define DOWN  6
 
 #define VERTEX_BUFLEN 100000
-#define SUNQLEN 10000
-#define GLOQLEN 10000
 
 #define SHADOW_SZ 4096
 
+#define LATTICE 4                  // spacing of the coarse noise lattice, must divide CHUNKW, CHUNKD
+#define LAT_P300 1                 // per-voxel noise octaves gen_chunk() can sample on the lattice
+#define LAT_P90  2                 // ^
+#define LAT_P91  4                 // ^
+
 #define CLAMP(v, l, u) { if (v < l) v = l; else if (v > u) v = u; }
 #define ICLAMP(v, l, u) ((v < l) ? l : (v > u) ? u : v)
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -135,29 +193,55 @@ struct osn_context *osn_context;
 #define FOG_NIGHT_B 0.06f
 
 // tile pos-to-mem-location macros
-#define T_(x,y,z)    tiles[    ((z - scootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - scootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define SUN_(x,y,z)  sunlight[ ((z - scootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - scootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define GLO_(x,y,z)  glolight[ ((z - scootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - scootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define CORN_(x,y,z) cornlight[((z - scootz) & (TILESD-1)) * (TILESH+1) * (TILESW+1) + ((x - scootx) & (TILESW-1)) * (TILESH+1) + (y)]
-#define KORN_(x,y,z) kornlight[((z - scootz) & (TILESD-1)) * (TILESH+1) * (TILESW+1) + ((x - scootx) & (TILESW-1)) * (TILESH+1) + (y)]
+#define T_(x,y,z)    get_tile((x - scootx) & (TILESW-1), (y), (z - scootz) & (TILESD-1))
+#define SET_T_(x,y,z,t) set_tile((x - scootx) & (TILESW-1), (y), (z - scootz) & (TILESD-1), (t))
+#define LIGHT_(x,y,z) lightmap[TILE_INDEX(x, y, z)]
+#define TILE_INDEX(x,y,z) MEM_INDEX((x - scootx) & (TILESW-1), (y), (z - scootz) & (TILESD-1))
 #define GNDH_(x,z)   gndheight[((z - scootz) & (TILESD-1))              * (TILESW+0) + ((x - scootx) & (TILESW-1))                   ]
 
+// sunlight in the high nibble of each lightmap byte, glow in the low
+#define SUN_(x,y,z)  (LIGHT_(x, y, z) >> 4)
+#define GLO_(x,y,z)  (LIGHT_(x, y, z) & 15)
+#define SET_SUN_(x,y,z,light) set_light_nibble(&LIGHT_(x, y, z), 4, (light))
+#define SET_GLO_(x,y,z,light) set_light_nibble(&LIGHT_(x, y, z), 0, (light))
+
 // for terrain/worker
-#define TT_(x,y,z)    tiles[    ((z - tscootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - tscootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define TSUN_(x,y,z)  sunlight[ ((z - tscootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - tscootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define TGLO_(x,y,z)  glolight[ ((z - tscootz) & (TILESD-1)) * (TILESH+0) * (TILESW+0) + ((x - tscootx) & (TILESW-1)) * (TILESH+0) + (y)]
-#define TCORN_(x,y,z) cornlight[((z - tscootz) & (TILESD-1)) * (TILESH+1) * (TILESW+1) + ((x - tscootx) & (TILESW-1)) * (TILESH+1) + (y)]
-#define TKORN_(x,y,z) kornlight[((z - tscootz) & (TILESD-1)) * (TILESH+1) * (TILESW+1) + ((x - tscootx) & (TILESW-1)) * (TILESH+1) + (y)]
+#define TT_(x,y,z)    get_tile((x - tscootx) & (TILESW-1), (y), (z - tscootz) & (TILESD-1))
+#define SET_TT_(x,y,z,t) set_tile((x - tscootx) & (TILESW-1), (y), (z - tscootz) & (TILESD-1), (t))
+#define TLIGHT_(x,y,z) lightmap[MEM_INDEX((x - tscootx) & (TILESW-1), (y), (z - tscootz) & (TILESD-1))]
 #define TGNDH_(x,z)   gndheight[((z - tscootz) & (TILESD-1))              * (TILESW+0) + ((x - tscootx) & (TILESW-1))                   ]
+#define SET_TSUN_(x,y,z,light) set_light_nibble(&TLIGHT_(x, y, z), 4, (light))
+
+// tile mem-location-to-section slot, same as SECT_(), and to index within the section
+#define TSECT(x,y,z)   ((((z) / CHUNKD) * (VAOW) + (x) / CHUNKW) * SECTIONS + (y) / SECTH)
+#define TSECT_I(x,y,z) ((((z) & (CHUNKD-1)) * CHUNKW + ((x) & (CHUNKW-1))) * SECTH + ((y) & (SECTH-1)))
+#define SECT_TILES (CHUNKW*CHUNKD*SECTH)
+
+// mem-location to index into lightmap and the light queues' bitmaps: a column at a
+// time, y fastest, or built with -DBRICKS a section at a time in the same order as
+// the tiles in it, so blocks next to each other in x and z are near in memory too
+#ifdef BRICKS
+        #define MEM_INDEX(x,y,z) (TSECT(x, y, z) * SECT_TILES + TSECT_I(x, y, z))
+#else
+        #define MEM_INDEX(x,y,z) (((z) * (TILESW+0) + (x)) * (TILESH+0) + (y))
+#endif
 
 // chunk pos-to-mem-location macros
 #define AGEN_(x,z)   already_generated[(z - chunk_scootz) & (VAOD-1)][(x - chunk_scootx) & (VAOW-1)]
-#define VAO_(x,z)    vbo[    ((z - chunk_scootz) & (VAOD-1)) * (VAOW) + ((x - chunk_scootx) & (VAOW-1))]
-#define VBO_(x,z)    vao[    ((z - chunk_scootz) & (VAOD-1)) * (VAOW) + ((x - chunk_scootx) & (VAOW-1))]
-#define VBOLEN_(x,z) vbo_len[((z - chunk_scootz) & (VAOD-1)) * (VAOW) + ((x - chunk_scootx) & (VAOW-1))]
+
+// section pos-to-slot, s counting sections down from the top of the world
+#define SECT_(x,s,z) ((((z - chunk_scootz) & (VAOD-1)) * (VAOW) + ((x - chunk_scootx) & (VAOW-1))) * SECTIONS + (s))
+#define VBOARENA_(x,s,z) vbo_arena[SECT_(x,s,z)]
+#define VBOFIRST_(x,s,z) vbo_first[SECT_(x,s,z)]
+#define VBOLEN_(x,s,z)   vbo_len[SECT_(x,s,z)]
+#define BOUNDS_(x,s,z)   section_bounds[SECT_(x,s,z)]
+#define DIRTY_(x,s,z)    chunk_dirty[SECT_(x,s,z)]
+#define LOD_(x,z)        chunk_lod[((z - chunk_scootz) & (VAOD-1)) * (VAOW) + ((x - chunk_scootx) & (VAOW-1))]
 
 // for terrain/worker
 #define TAGEN_(x,z)   already_generated[(z - tchunk_scootz) & (VAOD-1)][(x - tchunk_scootx) & (VAOW-1)]
+#define TBUSY_(x,z)   chunk_in_progress[(z - tchunk_scootz) & (VAOD-1)][(x - tchunk_scootx) & (VAOW-1)]
+#define TDIRTY_(x,s,z) chunk_dirty[(((z - tchunk_scootz) & (VAOD-1)) * (VAOW) + ((x - tchunk_scootx) & (VAOW-1))) * SECTIONS + (s)]
 
 // helper macros
 #define IS_OPAQUE(x,y,z) (T_(x, y, z) < LASTSOLID)
@@ -180,7 +264,7 @@ struct osn_context *osn_context;
 // dumb rand -- for simple deterministic rand
 unsigned dumb_rand(unsigned *seed) { return (*seed = (1103515245 * *seed + 12345) % 2147483648); }
 // helpers for dumb rand, must have local var called seed for all of these
-#define RAND (abs(dumb_rand(&seed)))
+#define RAND ((int)dumb_rand(&seed)) // dumb_rand() stays under 2^31
 // random float in the range 0-1
 #define RAND01 ((double)RAND / 2147483648.0)
 // random int in the range lo to hi
@@ -199,35 +283,133 @@ unsigned dumb_rand(unsigned *seed) { return (*seed = (1103515245 * *seed + 12345
 
 float lerp(float t, float a, float b) { return a + t * (b - a); }
 
-unsigned int vbo[VAOS], vao[VAOS];
-size_t vbo_len[VAOS];
-
-struct vbufv { // vertex buffer vertex
-        float tex;
-        float orient;
-        float x, y, z;
-        float illum0, illum1, illum2, illum3;
-        float glow0, glow1, glow2, glow3;
-        float alpha;
+// section meshes are sub-allocated out of big arena buffers, see upload.c
+// one to start with, so draw_sections() can draw everything in one call, and it
+// holds the whole world at full detail meshed plainly (5.9m points, bench lod 4096)
+// but not with room to grow as well, so more are made when it fills
+#define ARENAS 4
+#define ARENA_LEN (1 << 23)          // points per arena
+int nr_arenas;
+struct span { unsigned first, len; };
+struct arena {
+        unsigned int vao, vbo;
+        struct span free[VAOS * SECTIONS + 1]; // unused spans of points, in order
+        int nr_free;
+} arenas[ARENAS];
+
+// per section slot: where the section's mesh is, how many points, and room for how many
+unsigned char vbo_arena[VAOS * SECTIONS];
+unsigned vbo_first[VAOS * SECTIONS];
+size_t vbo_len[VAOS * SECTIONS];
+unsigned vbo_room[VAOS * SECTIONS];
+
+// per section slot: how far up and down its mesh goes, and whether it's opaque
+// all the way through, see find_section_bounds()
+struct section_bounds {
+        unsigned char ylo, yhi; // mesh is within ylo <= y < yhi, in blocks
+        unsigned char full;     // every tile is opaque
+} section_bounds[VAOS * SECTIONS];
+
+// chunk quadtree for frustum culling, rebuilt each frame from section_bounds:
+// level 0 has a node per chunk, each level up has a node per 2x2 nodes of the one below
+#define QUAD_LEVELS 7 // log2(VAOW) + 1, and VAOW == VAOD
+struct quad_node {
+        unsigned char ylo, yhi; // of the meshes under it
+        int meshed;             // sections under it with a mesh
+} quadtree[QUAD_LEVELS][VAOS];
+
+// chunks at least lod_rings[i] rings out from the camera's (the farther of x and z,
+// in chunks) are meshed with cells of 1 << i blocks on a side, the farthest as a
+// heightmap, see lod.c
+#define LODS 4
+int lod_rings[LODS] = { 0, 8, 14, 20 };
+#define LOD_SKIRT 4 // blocks, how far heightmap walls hang down past the edges of a chunk
+volatile char chunk_lod[VAOS]; // what each chunk is meshed at, by vbo slot
+int chunks_at_lod[LODS];       // last frame
+
+// low-res depth buffer of the main view for occlusion culling, holding how far
+// away something solid is sure to be, see occlusion_cull()
+#define OCC_W 128
+#define OCC_H 64
+#define OCC_RANGE 6 // in chunks, farther away occluders hide little for what they cost
+float occ_depth[OCC_H][OCC_W];
+
+// meshes get to the arenas by way of a persistently mapped staging ring, one
+// section per frame in flight, or by glBufferSubData without ARB_buffer_storage
+#define RING_SECTIONS 3
+#define RING_SECTION_SZ (4 << 20) // bytes
+int use_buffer_storage;
+int use_multi_draw;         // ARB_multi_draw_indirect and ARB_base_instance, see draw_sections()
+unsigned int origin_vbo;    // chunk origin per draw
+unsigned int indirect_vbo;  // draw commands
+unsigned int ring_vbo;
+unsigned char *ring_map;
+GLsync ring_fences[RING_SECTIONS];
+int ring_section;
+size_t ring_used; // bytes of the current section
+size_t bytes_uploaded, most_bytes_uploaded; // since debrief() last looked
+int arena_outta_room;
+volatile char chunk_dirty[VAOS * SECTIONS]; // mesh is out of date, by section slot
+
+struct vbufv { // vertex buffer vertex, packed, see pack_point() and shaders/main.vert
+        unsigned pos;           // x:9 z:9 y:12 in 16ths of a block, plus 1 block so never negative
+        unsigned info;          // tex:8 orient:3 width-1:4 height-1:8 alpha:8, width/height in blocks
+        unsigned char illum[4]; // in 125ths, so corner light (0.008 * sum of 8 light levels) is exact
+        unsigned char glow[4];  // ^
 };
 
-struct vbufv vbuf[VERTEX_BUFLEN + 1000]; // vertex buffer + padding
-struct vbufv *v_limit = vbuf + VERTEX_BUFLEN;
-struct vbufv *v = vbuf;
+// each mesh worker's own scratch buffers, allocated by mesh_section() on first use
+struct vbufv *vbuf, *v_limit, *v; // vertex buffer
+struct vbufv *wbuf, *w_limit, *w; // water buffer
+#pragma omp threadprivate(vbuf, v_limit, v, wbuf, w_limit, w)
+
+struct mesh_job { int x, sy, z, scootx, scootz, slot; unsigned gen; }; // section to mesh, the scoot when asked, slot
+struct mesh_job mesh_jobs[VAOS * SECTIONS];    // ring of sections waiting for a mesh worker
+size_t mesh_jobs_head, mesh_jobs_len;
+char mesh_job_queued[VAOS * SECTIONS];         // by section slot, so a section is only queued once
+unsigned mesh_job_gen[VAOS * SECTIONS];        // by section slot, up one each time it's queued
+
+struct chunk_mesh { // finished section mesh waiting to be uploaded
+        struct chunk_mesh *next;
+        int x, sy, z, scootx, scootz, slot;
+        unsigned gen; // its job's, older than mesh_job_gen[slot] if it's been queued again since
+        size_t len;
+        struct section_bounds bounds;
+        struct vbufv verts[];
+};
+struct chunk_mesh *ready_meshes, *ready_meshes_tail; // oldest first
 
-struct vbufv wbuf[VERTEX_BUFLEN + 1000]; // water buffer
-struct vbufv *w_limit = wbuf + VERTEX_BUFLEN;
-struct vbufv *w = wbuf;
+SDL_mutex *mesh_queue_lock;   // for all of the above
+SDL_cond *mesh_queue_changed; // signaled when there are mesh jobs
 
 float fog_r, fog_g, fog_b;
 
-unsigned char *tiles;
-unsigned char *sunlight;
-unsigned char *glolight;
+// tiles a section at a time, see tiles.c and T_()
+struct tile_block {
+        unsigned char bits;        // per tile: 0 for all palette[0], 1, 2 or 4 to index the palette, 8 for plain tiles
+        unsigned char palette[16];
+        unsigned char data[];
+};
+struct tile_block *volatile tile_sections[VAOS * SECTIONS]; // by section slot
+struct tile_block *uniform_blocks[256];                     // shared by sections all of one tile
+volatile char tiles_loose[VAOS];   // by chunk slot, some section in it is plain tiles
+struct retired_block { struct tile_block *b; unsigned epoch; } *retired_blocks; // replaced, not yet freed
+size_t retired_len, retired_room;
+volatile unsigned tile_epoch;      // goes up by one each compact_tiles()
+#define TILE_READERS 256           // most threads reading tiles, by omp thread number
+#define TILE_IDLE 0xffffffffu      // a reader between jobs, holding no blocks
+volatile unsigned tile_readers[TILE_READERS]; // tile_epoch as each reader's job began, see begin_tile_reads()
+#define TILE_COMPACT_CHUNKS 8      // most chunks compact_tiles() packs a frame
+unsigned char *lightmap; // see SUN_ and GLO_
 unsigned char gndheight[TILESW * TILESD];
-float *cornlight;
-float *kornlight;
 volatile char already_generated[VAOW][VAOD];
+volatile char chunk_in_progress[VAOW][VAOD];
+char column_already_generated[TILESW][TILESD]; // by gen_chunk(), or loaded
+int hmap_created;
+int nr_chunks_in_progress;
+SDL_mutex *chunk_queue_lock;     // for the above, and terrain.c's chunk queue
+SDL_cond *chunk_queue_changed;   // signaled when there may be a chunk to claim
+volatile int stop_chunk_builders;
 
 int future_scootx, future_scootz; // pending global map offset
 int scootx, scootz;               // actual global map offset
@@ -243,22 +425,70 @@ struct point { float x, y, z; };
 struct qchunk { int x, y, z, sqdist; };
 struct qitem { int x, y, z; };
 
-struct qitem sunq0_[SUNQLEN+1];
-struct qitem sunq1_[SUNQLEN+1];
-struct qitem *sunq_curr = sunq0_;
-struct qitem *sunq_next = sunq1_;
-size_t sq_curr_len;
-size_t sq_next_len;
-
-struct qitem gloq0_[GLOQLEN+1];
-struct qitem gloq1_[GLOQLEN+1];
-struct qitem *gloq_curr = gloq0_;
-struct qitem *gloq_next = gloq1_;
-size_t gq_curr_len;
-size_t gq_next_len;
+// blocks waiting to spread their light, a wave at a time: spreading from the
+// current wave queues up the next, see step_sunlight()
+struct light_wave { struct qitem *items; size_t len, room; }; // grows as needed
+struct light_queue {
+        struct light_wave wave[2]; // wave[gen & 1] is current, the other is next
+        unsigned char *queued[2];  // a bit per block, set while it waits in wave[i]
+        unsigned gen;              // goes up by one each step
+        size_t next;               // how far into the current wave it's spread
+};
+struct light_queue sunq, gloq;
+#define QUEUED_BYTES (TILESD * TILESH * TILESW / 8)
+
+// step_light() spreads for this long each frame, nearest the camera first
+#define LIGHT_BUDGET_US 2000
+#define LIGHT_NEAR (CHUNKW*2)      // how close to the camera is near
+#define LIGHT_BATCH 256            // blocks spread between looks at the clock
+int light_budget_us = LIGHT_BUDGET_US;
+
+// saved worlds, see save.c
+#define SAVE_REGION 16                            // chunks a side in each region file
+#define REGION_VERSION 1
+#define REGION_HEAD (8 + 8 * SAVE_REGION * SAVE_REGION) // magic, version and chunk table
+#define CHUNK_TILES (CHUNKW * CHUNKD * TILESH)
+#define CHUNK_BYTES (2 * CHUNK_TILES + CHUNKW * CHUNKD) // tiles, light, gndheight
+#define SAVE_CHUNKS 4                             // most chunks save_chunks() saves a frame
+char *save_dir = "saves";
+SDL_mutex *region_lock;                           // for the region files
+volatile char chunk_unsaved[VAOD][VAOW];          // by chunk pos, changed since it was saved
+int light_pending[VAOD][VAOW];                    // by chunk pos, blocks waiting in the light queues
+int seeds_pending[VAOD][VAOW];                    // and sun seeds not taken yet, see sun_seed()
+volatile int nr_chunks_loaded;
+int save_failures;
+
+// sunlight left by chunk builders for the main thread to spread
+struct qlight { int x, y, z; int light; };
+struct qlight *sun_seeds;                          // grows as needed, like the light waves
+size_t sun_seeds_len, sun_seeds_room;
+
+// blocks being darkened by remove_sunlight() and remove_glolight(), with the light
+// each had; no block goes in twice, and it grows as needed, see dark_queue_push()
+struct qlight *dark_queue;
+size_t dark_queue_room;
 
 struct qcave { int x, y, z; int radius_sq; };
 
+#define REGW (CHUNKW*16)           // cave system region size
+#define REGD (CHUNKD*16)           // ^
+#define MAX_CAVE_POINTS 10000      // per chunk
+#define MAX_CAVE_CURVES 100        // per region
+#define QCAVE(x,y,z,radius_sq) ((struct qcave){x, y, z, radius_sq})
+
+struct cave_curve {
+        int xlo, xhi, zlo, zhi;    // bounds of the points on this curve
+        int start, len;            // range of points in cave_region.points
+};
+
+struct cave_region {
+        volatile int ready;
+        int nr_curves;
+        struct cave_curve curves[MAX_CAVE_CURVES + 1]; // RANDI is inclusive
+        struct qcave *points;
+        int len;
+};
+
 struct player {
         struct box pos;
         struct point vel;
@@ -309,6 +539,52 @@ GLuint shadow_fbo;
 unsigned int prog_id;
 unsigned int shadow_prog_id;
 
+// uniforms outside the frame block, looked up once when a program is linked,
+// see find_uniforms()
+#define UNIFORMS \
+        X(tarray), \
+        X(shadow_map), \
+        X(proj), \
+        X(view), \
+        X(model), \
+        X(tex), \
+        X(incolor),
+
+enum uniform_names {
+        #define X(x) U_ ## x
+        UNIFORMS
+        #undef X
+        NR_UNIFORMS
+};
+
+char *uniform_names[] = {
+        #define X(x) #x
+        UNIFORMS
+        #undef X
+};
+
+GLint prog_uniforms[NR_UNIFORMS];
+GLint shadow_prog_uniforms[NR_UNIFORMS];
+
+// per-frame constants shared by the main and shadow programs through one
+// uniform buffer, laid out std140 to match the frame block in the shaders
+#define FRAME_BINDING 0
+struct frame_uniforms {
+        float pv[16];           // camera proj * view
+        float shadow_pv[16];    // sun or moon proj * view, for the shadow pass
+        float shadow_space[16]; // world to shadow map
+        float light_pos[4];
+        float view_pos[4];
+        float day_color[4];
+        float glo_color[4];
+        float fog_color[4];
+        float block_size;       // BS, called that in the shaders
+        float sharpness;
+        int shadow_mapping;
+        int water_frame;
+} frame_uniforms;
+unsigned int frame_ubo;
+
 //globals
 int frame = 0;
 int pframe = 0;
@@ -321,11 +597,22 @@ int show_shadow_map = false;
 int help_layer = 1;
 int polys = 0;
 int shadow_polys = 0;
+int sections_drawn = 0;          // last frame, and why the rest weren't
+int sections_out_of_view = 0;
+int sections_occluded = 0;
+int shadow_sections_culled = 0;
+int meshes_uploaded = 0;
 int sunq_outta_room = 0;
 int gloq_outta_room = 0;
 int omp_threads = 0;
+int chunk_workers = 1;
+int mesh_workers = 1;
+int lattice_octaves = LAT_P300 | LAT_P90 | LAT_P91;
 int lock_culling = false;
 int frustum_culling = true;
+int occlusion_culling = true;
+int greedy_meshing = false;
+int lod_meshing = true;
 int zooming = false;
 float zoom_amt = 1.f;
 float fast = 1.f;
@@ -342,15 +629,15 @@ int target_x, target_y, target_z;
 int place_x, place_y, place_z;
 int screenw = W;
 int screenh = H;
-volatile struct qitem just_generated[VAOW*VAOD];
-volatile size_t just_gen_len;
-
-int nr_chunks_generated = 0;
+volatile int nr_chunks_generated = 0;
 int chunk_gen_ticks = 0;
 
 // glsetup.c protos
+void load_shaders();
+void find_uniforms(GLuint prog, GLint *locs);
 int check_program_errors(GLuint shader, char *name);
 unsigned int file2shader(unsigned int type, char *filename);
+int new_arena();
 
 // font.c protos
 void font_begin(int w, int h);
@@ -373,20 +660,103 @@ int in_test_area(int x, int y, int z);
 void build_test_area();
 void debrief();
 
+// mesh.c protos
+int solid_tex(int t, int orient);
+struct vbufv pack_point(int tex, int orient, float x, float y, float z,
+                float il0, float il1, float il2, float il3, float gl0, float gl1, float gl2, float gl3,
+                float alpha, int width, int height);
+void reset_mesh_buffers();
+void dirty_blocks(int xlo, int xhi, int ylo, int yhi, int zlo, int zhi);
+void dirty_block(int x, int y, int z);
+void dirty_tiles(int xlo, int xhi, int zlo, int zhi);
+void dirty_all_chunks();
+int section_empty(int xlo, int ylo, int zlo);
+int section_full(int xlo, int ylo, int zlo);
+int section_buried(int xlo, int ylo, int zlo);
+size_t mesh_section(int xlo, int ylo, int zlo);
+struct section_bounds find_section_bounds(int xlo, int ylo, int zlo, size_t len);
+void request_meshes(struct qitem *sections, size_t len);
+struct chunk_mesh *take_ready_meshes();
+void return_ready_meshes(struct chunk_mesh *m);
+int build_mesh(int wait);
+void mesh_builder();
+
+// lod.c protos
+int pick_lod(int cur, int ring);
+size_t mesh_lod_section(int xlo, int ylo, int zlo, int lod);
+
+// cull.c protos
+void build_chunk_quadtree();
+size_t frustum_cull(float *matrix, struct qitem *out, int *culled);
+size_t occlusion_cull(float *matrix, struct qitem *sections, size_t len, int *culled);
+
+// draw.c protos
+void upload_frame_uniforms();
+int section_key(int i, int s, int j, float eye0, float eye1, float eye2);
+void draw_sections(struct qitem *sections, size_t len, int *polys_drawn);
+
+// upload.c protos
+size_t upload_meshes(struct qitem *shipped);
+
 // light.c protos
-void sun_enqueue(int x, int y, int z, int base, unsigned char incoming_light);
-void glo_enqueue(int x, int y, int z, int base, unsigned char incoming_light);
+int cas_byte(unsigned char *b, unsigned char *old, unsigned char new);
+void set_light_nibble(unsigned char *b, int shift, int light);
+int alloc_light_queue(struct light_queue *q);
+int light_queue_push(struct light_queue *q, int x, int y, int z);
+void light_queue_pop(struct light_queue *q, int x, int y, int z);
+unsigned char filter_light(int x, int y, int z, unsigned char light);
+void sun_enqueue(int x, int y, int z, unsigned char incoming_light);
+void glo_enqueue(int x, int y, int z, unsigned char incoming_light);
+void sun_seed(int x, int y, int z, unsigned char light);
+size_t take_sun_seeds(size_t n);
+void dark_queue_push(int x, int y, int z, unsigned char light, size_t *len);
+size_t light_queue_swap(struct light_queue *q);
+size_t light_queue_depth(struct light_queue *q);
+void light_queue_near_first(struct light_queue *q, int ex, int ez);
+void spread_sunlight(int x, int y, int z);
+void spread_glolight(int x, int y, int z);
+int spread_wave(struct light_queue *q, void (*spread)(int x, int y, int z), size_t n);
 int step_sunlight();
 int step_glolight();
+int step_light(int budget_us, int ex, int ez);
+void sun_darken(int x, int y, int z, unsigned char light, size_t *len);
+void glo_darken(int x, int y, int z, unsigned char light, size_t *len);
+void set_sunlight(int x, int y, int z, int light);
+void set_glolight(int x, int y, int z, int light);
+void corner_light(int x, int y, int z, float *sun, float *glo);
 void remove_sunlight(int px, int py, int pz);
 void remove_glolight(int px, int py, int pz);
+void recalc_gndheight(int x, int z);
+void light_placed_block(int x, int y, int z);
+void light_broken_block(int x, int y, int z, int broken);
+
+// tiles.c protos
+int alloc_tiles();
+unsigned char get_tile(unsigned x, unsigned y, unsigned z);
+void set_tile(unsigned x, unsigned y, unsigned z, unsigned char t);
+void retire_block(struct tile_block *b);
+void begin_tile_reads();
+void end_tile_reads();
+void free_retired_tiles();
+struct tile_block *loosen_section(size_t s);
+void compact_section(size_t s);
+int compact_tiles(int max_chunks);
+size_t tile_bytes(size_t *counts);
+
+// save.c protos
+size_t rle_encode(unsigned char *in, size_t len, unsigned char *out);
+int rle_decode(unsigned char *in, size_t len, unsigned char *out, size_t out_len);
+void region_path(char *path, size_t len, int chunk_x, int chunk_z, int make_dirs);
+void gather_chunk(int chunk_x, int chunk_z, unsigned char *raw);
+void scatter_chunk(int chunk_x, int chunk_z, unsigned char *raw);
+int save_chunk(int chunk_x, int chunk_z, unsigned char *raw);
+int load_chunk(int chunk_x, int chunk_z);
+void mark_unsaved(int x, int z);
+int save_chunks(int max_chunks);
+void save_all_chunks();
 
 // main.c protos
-void recalc_corner_lighting(int xlo, int xhi, int zlo, int zhi);
-void set_sunlight(int xlo, int ylo, int zlo, int light);
-void set_glolight(int xlo, int ylo, int zlo, int light);
 void rayshot(float eye0, float eye1, float eye2, float f0, float f1, float f2);
 void move_to_ground(float *inout, int x, int y, int z);
-void recalc_gndheight(int x, int z);
 void scoot(int x, int z);
 void apply_scoot();
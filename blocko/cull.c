@@ -0,0 +1,344 @@
+#include "blocko.h"
+
+enum { OUTSIDE, PARTLY, INSIDE };
+
+// whether a box in world units is outside, partly inside or all the way inside
+// the frustum of matrix
+int box_in_frustum(float *matrix, float x0, float y0, float z0, float x1, float y1, float z1)
+{
+        int x_too_lo = 0;
+        int x_too_hi = 0;
+        int y_too_lo = 0;
+        int y_too_hi = 0;
+        int z_too_lo = 0;
+        int z_too_hi = 0;
+        int w_too_lo = 0;
+
+        for (int x = 0; x <= 1; x++) for (int z = 0; z <= 1; z++) for (int y = 0; y <= 1; y++)
+        {
+                float v[4];
+                mat4_f3_multiply(v, matrix, x ? x1 : x0, y ? y1 : y0, z ? z1 : z0);
+                if (v[0] < -v[3]) x_too_lo++;
+                if (v[0] >  v[3]) x_too_hi++;
+                if (v[1] < -v[3]) y_too_lo++;
+                if (v[1] >  v[3]) y_too_hi++;
+                if (v[2] < -v[3]) z_too_lo++;
+                if (v[2] >  v[3]) z_too_hi++;
+                if (v[3] <   0.f) w_too_lo++;
+        }
+
+        if (x_too_lo == 8 || x_too_hi == 8 ||
+            y_too_lo == 8 || y_too_hi == 8 ||
+            z_too_lo == 8 || z_too_hi == 8 ||
+            w_too_lo == 8)
+                return OUTSIDE;
+
+        if (x_too_lo || x_too_hi || y_too_lo || y_too_hi || z_too_lo || z_too_hi || w_too_lo)
+                return PARTLY;
+
+        return INSIDE;
+}
+
+// sum up the section bounds into the quadtree, after the frame's meshes are uploaded
+void build_chunk_quadtree()
+{
+        for (int j = 0; j < VAOD; j++) for (int i = 0; i < VAOW; i++)
+        {
+                struct quad_node *n = quadtree[0] + j * VAOW + i;
+                *n = (struct quad_node){ TILESH, 0, 0 };
+
+                for (int s = 0; s < SECTIONS; s++)
+                {
+                        if (!VBOLEN_(i, s, j)) continue;
+                        struct section_bounds *b = &BOUNDS_(i, s, j);
+                        n->ylo = MIN(n->ylo, b->ylo);
+                        n->yhi = MAX(n->yhi, b->yhi);
+                        n->meshed++;
+                }
+        }
+
+        for (int k = 1; k < QUAD_LEVELS; k++)
+        {
+                int w = VAOW >> k;
+                for (int j = 0; j < w; j++) for (int i = 0; i < w; i++)
+                {
+                        struct quad_node *n = quadtree[k] + j * w + i;
+                        *n = (struct quad_node){ TILESH, 0, 0 };
+
+                        for (int c = 0; c < 4; c++)
+                        {
+                                struct quad_node *m = quadtree[k-1] + (2*j + c/2) * 2*w + 2*i + c%2;
+                                if (!m->meshed) continue;
+                                n->ylo = MIN(n->ylo, m->ylo);
+                                n->yhi = MAX(n->yhi, m->yhi);
+                                n->meshed += m->meshed;
+                        }
+                }
+        }
+}
+
+// add the sections with meshes under node i, j of level k that could be seen
+// with matrix to out, counting the rest in culled, test false if the node is
+// known to be all the way inside
+void cull_node(float *matrix, int k, int i, int j, int test, struct qitem *out, size_t *len, int *culled)
+{
+        struct quad_node *n = quadtree[k] + j * (VAOW >> k) + i;
+        if (!n->meshed) return;
+
+        if (test)
+        {
+                int in = box_in_frustum(matrix,
+                                (i << k) * CHUNKW * BS, n->ylo * BS, (j << k) * CHUNKD * BS,
+                                ((i + 1) << k) * CHUNKW * BS, n->yhi * BS, ((j + 1) << k) * CHUNKD * BS);
+
+                if (in == OUTSIDE)
+                {
+                        *culled += n->meshed;
+                        return;
+                }
+
+                test = (in == PARTLY);
+        }
+
+        if (!k)
+        {
+                for (int s = 0; s < SECTIONS; s++)
+                {
+                        if (!VBOLEN_(i, s, j)) continue;
+                        struct section_bounds *b = &BOUNDS_(i, s, j);
+
+                        if (test && box_in_frustum(matrix,
+                                                i * CHUNKW * BS, b->ylo * BS, j * CHUNKD * BS,
+                                                (i + 1) * CHUNKW * BS, b->yhi * BS, (j + 1) * CHUNKD * BS) == OUTSIDE)
+                                (*culled)++;
+                        else
+                                out[(*len)++] = (struct qitem){ i, s, j };
+                }
+                return;
+        }
+
+        for (int c = 0; c < 4; c++)
+                cull_node(matrix, k - 1, 2*i + c%2, 2*j + c/2, test, out, len, culled);
+}
+
+// list the sections with meshes (x, y is the section, z) that could be in the
+// frustum of matrix, or all of them with frustum culling off, returns how many
+// and counts the rest in culled
+size_t frustum_cull(float *matrix, struct qitem *out, int *culled)
+{
+        size_t len = 0;
+        *culled = 0;
+        cull_node(matrix, QUAD_LEVELS - 1, 0, 0, frustum_culling, out, &len, culled);
+        return len;
+}
+
+// world point to occlusion buffer pixels and distance, false if it's too close to
+// the camera (or behind it) to say
+#define OCC_NEAR 8.f // same as the near plane in draw_stuff()
+int occ_project(float *matrix, float x, float y, float z, float *out)
+{
+        float v[4];
+        mat4_f3_multiply(v, matrix, x, y, z);
+        if (v[3] < OCC_NEAR) return false;
+
+        out[0] = (v[0] / v[3] * 0.5f + 0.5f) * OCC_W;
+        out[1] = (v[1] / v[3] * 0.5f + 0.5f) * OCC_H;
+        out[2] = v[3];
+        return true;
+}
+
+// corners of each face of a box, going around, with bit 0 for x1, bit 1 for y1
+// and bit 2 for z1
+int box_faces[6][4] = {
+        { 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+        { 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+        { 0, 1, 3, 2 }, { 4, 5, 7, 6 },
+};
+
+// draw a projected face into the depth buffer at its farthest corner's distance,
+// and only over pixels it covers all of, so it never claims more is hidden than is
+void occ_fill_face(float (*p)[3])
+{
+        float area = 0;
+        float far = 0;
+        float lo[2] = { INFINITY, INFINITY };
+        float hi[2] = { -INFINITY, -INFINITY };
+
+        for (int e = 0; e < 4; e++)
+        {
+                float *a = p[e];
+                float *b = p[(e + 1) % 4];
+                area += a[0] * b[1] - b[0] * a[1];
+                far = MAX(far, a[2]);
+                for (int d = 0; d < 2; d++)
+                {
+                        lo[d] = MIN(lo[d], a[d]);
+                        hi[d] = MAX(hi[d], a[d]);
+                }
+        }
+
+        if (fabsf(area) < 0.01f) return; // edge on
+        float sign = area > 0 ? 1.f : -1.f;
+
+        // each edge as e(x, y) = ex * x + ey * y + e0, positive inside, with the
+        // pixel corner that gives the least of it folded into e0
+        float ex[4], ey[4], e0[4];
+        for (int e = 0; e < 4; e++)
+        {
+                float *a = p[e];
+                float *b = p[(e + 1) % 4];
+                ex[e] = -sign * (b[1] - a[1]);
+                ey[e] =  sign * (b[0] - a[0]);
+                e0[e] = -ex[e] * a[0] - ey[e] * a[1] + MIN(ex[e], 0.f) + MIN(ey[e], 0.f);
+        }
+
+        int y0 = MAX((int)floorf(lo[1]), 0);
+        int y1 = MIN((int)ceilf(hi[1]), OCC_H);
+
+        for (int y = y0; y < y1; y++)
+        {
+                // each edge keeps x on one side of where it crosses this row
+                float xlo = MAX(floorf(lo[0]), 0.f);
+                float xhi = MIN(ceilf(hi[0]), (float)OCC_W);
+                for (int e = 0; e < 4; e++)
+                {
+                        float rest = ey[e] * y + e0[e];
+                        if (ex[e] > 0)
+                                xlo = MAX(xlo, ceilf(-rest / ex[e]));
+                        else if (ex[e] < 0)
+                                xhi = MIN(xhi, floorf(-rest / ex[e]) + 1);
+                        else if (rest < 0)
+                                xhi = xlo;
+                }
+
+                for (int x = xlo; x < xhi; x++)
+                        if (occ_depth[y][x] > far)
+                                occ_depth[y][x] = far;
+        }
+}
+
+// where the eye of a perspective matrix is, the point with clip x, y and w all 0
+void eye_of(float *m, float *eye)
+{
+        // rows 0, 1 and 3 of m, as a x + b y + c z = -d
+        float a[3] = { m[0], m[1], m[3] };
+        float b[3] = { m[4], m[5], m[7] };
+        float c[3] = { m[8], m[9], m[11] };
+        float d[3] = { -m[12], -m[13], -m[15] };
+        #define DET3(p, q, r) (p[0] * (q[1] * r[2] - q[2] * r[1]) \
+                             - q[0] * (p[1] * r[2] - p[2] * r[1]) \
+                             + r[0] * (p[1] * q[2] - p[2] * q[1]))
+        float det = DET3(a, b, c);
+        eye[0] = DET3(d, b, c) / det;
+        eye[1] = DET3(a, d, c) / det;
+        eye[2] = DET3(a, b, d) / det;
+        #undef DET3
+}
+
+// draw a solid box into the depth buffer, the sides facing the eye first, then
+// the far sides to fill in pixels that straddle two near ones
+void occ_fill_box(float *matrix, float *eye, float x0, float y0, float z0, float x1, float y1, float z1)
+{
+        float p[8][3];
+
+        for (int c = 0; c < 8; c++)
+                if (!occ_project(matrix, c & 1 ? x1 : x0, c & 2 ? y1 : y0, c & 4 ? z1 : z0, p[c]))
+                        return; // too close, leave it out rather than guess
+
+        int facing[6] = { eye[0] < x0, eye[0] > x1, eye[1] < y0, eye[1] > y1, eye[2] < z0, eye[2] > z1 };
+
+        for (int pass = 1; pass >= 0; pass--) for (int f = 0; f < 6; f++)
+        {
+                if (facing[f] != pass) continue;
+
+                float q[4][3];
+                for (int c = 0; c < 4; c++)
+                        memcpy(q[c], p[box_faces[f][c]], sizeof *q);
+                occ_fill_face(q);
+        }
+}
+
+// whether the box is sure to be behind what's in the depth buffer
+int occ_hidden(float *matrix, float x0, float y0, float z0, float x1, float y1, float z1)
+{
+        float lo[2] = { INFINITY, INFINITY };
+        float hi[2] = { -INFINITY, -INFINITY };
+        float near = INFINITY;
+
+        for (int c = 0; c < 8; c++)
+        {
+                float p[3];
+                if (!occ_project(matrix, c & 1 ? x1 : x0, c & 2 ? y1 : y0, c & 4 ? z1 : z0, p))
+                        return false;
+
+                for (int d = 0; d < 2; d++)
+                {
+                        lo[d] = MIN(lo[d], p[d]);
+                        hi[d] = MAX(hi[d], p[d]);
+                }
+                near = MIN(near, p[2]);
+        }
+
+        int px0 = MAX((int)floorf(lo[0]), 0);
+        int py0 = MAX((int)floorf(lo[1]), 0);
+        int px1 = MIN((int)ceilf(hi[0]), OCC_W);
+        int py1 = MIN((int)ceilf(hi[1]), OCC_H);
+        if (px0 >= px1 || py0 >= py1)
+                return false; // off screen, that's for the frustum to say
+
+        for (int y = py0; y < py1; y++) for (int x = px0; x < px1; x++)
+                if (occ_depth[y][x] >= near)
+                        return false;
+
+        return true;
+}
+
+// drop sections hidden behind the solid sections of chunks within OCC_RANGE, seen
+// with matrix, returns how many are left and counts the rest in culled
+size_t occlusion_cull(float *matrix, struct qitem *sections, size_t len, int *culled)
+{
+        for (int y = 0; y < OCC_H; y++) for (int x = 0; x < OCC_W; x++)
+                occ_depth[y][x] = INFINITY;
+
+        float eye[3];
+        eye_of(matrix, eye);
+
+        int ex = (int)floorf(eye[0] / (CHUNKW * BS));
+        int ez = (int)floorf(eye[2] / (CHUNKD * BS));
+
+        for (int j = MAX(ez - OCC_RANGE, 0); j <= MIN(ez + OCC_RANGE, VAOD - 1); j++)
+                for (int i = MAX(ex - OCC_RANGE, 0); i <= MIN(ex + OCC_RANGE, VAOW - 1); i++)
+        {
+                float x0 = i * CHUNKW * BS;
+                float z0 = j * CHUNKD * BS;
+                float dx = (x0 + CHUNKW2 * BS - eye[0]) / (CHUNKW * BS);
+                float dz = (z0 + CHUNKD2 * BS - eye[2]) / (CHUNKD * BS);
+                if (dx * dx + dz * dz > OCC_RANGE * OCC_RANGE) continue;
+
+                // each run of solid sections as one box
+                for (int s = 0, t; s < SECTIONS; s = t + 1)
+                {
+                        for (t = s; t < SECTIONS && BOUNDS_(i, t, j).full; t++)
+                                ;
+                        if (t > s)
+                                occ_fill_box(matrix, eye, x0, s * SECTH * BS, z0,
+                                                x0 + CHUNKW * BS, t * SECTH * BS, z0 + CHUNKD * BS);
+                }
+        }
+
+        size_t kept = 0;
+        *culled = 0;
+        for (size_t k = 0; k < len; k++)
+        {
+                struct section_bounds *b = &BOUNDS_(sections[k].x, sections[k].y, sections[k].z);
+                float x0 = sections[k].x * CHUNKW * BS;
+                float z0 = sections[k].z * CHUNKD * BS;
+
+                if (occ_hidden(matrix, x0, b->ylo * BS, z0, x0 + CHUNKW * BS, b->yhi * BS, z0 + CHUNKD * BS))
+                        (*culled)++;
+                else
+                        sections[kept++] = sections[k];
+        }
+
+        return kept;
+}
@@ -26,36 +26,9 @@ int sorter(const void * _a, const void * _b)
                (a->y <  b->y) ?  1 : -1;
 }
 
-int chunk_in_frustum(float *matrix, int chunk_x, int chunk_z)
+int nearest_sorter(const void * _a, const void * _b)
 {
-        int x_too_lo = 0;
-        int x_too_hi = 0;
-        int y_too_lo = 0;
-        int y_too_hi = 0;
-        int z_too_lo = 0;
-        int z_too_hi = 0;
-        int w_too_lo = 0;
-
-        for (int x = 0; x <= 1; x++) for (int z = 0; z <= 1; z++) for (int y = 0; y <= 1; y++)
-        {
-                float v[4];
-                mat4_f3_multiply(v, matrix,
-                                chunk_x*BS*CHUNKW + x*BS*CHUNKW,
-                                0 + y*BS*TILESH, // TODO: use highest gndheight?
-                                chunk_z*BS*CHUNKD + z*BS*CHUNKD);
-                if (v[0] < -v[3]) x_too_lo++;
-                if (v[0] >  v[3]) x_too_hi++;
-                if (v[1] < -v[3]) y_too_lo++;
-                if (v[1] >  v[3]) y_too_hi++;
-                if (v[2] < -v[3]) z_too_lo++;
-                if (v[2] >  v[3]) z_too_hi++;
-                if (v[3] <   0.f) w_too_lo++;
-        }
-
-        return x_too_lo != 8 && x_too_hi != 8 &&
-               y_too_lo != 8 && y_too_hi != 8 &&
-               z_too_lo != 8 && z_too_hi != 8 &&
-               w_too_lo != 8;
+        return sorter(_b, _a);
 }
 
 // prevent shaking shadows by quantizing sun or moon pitch
@@ -73,21 +46,100 @@ float quantize(float p)
         return roundf(p / quantizer) * quantizer;
 }
 
+// distance sq in blocks from the eye to the middle of section s of chunk i, j,
+// times SECTIONS plus s, so sorting by it keeps which section it is
+int section_key(int i, int s, int j, float eye0, float eye1, float eye2)
+{
+        int xd = (i * CHUNKW + CHUNKW2) - eye0 / BS;
+        int yd = (s * SECTH + SECTH / 2) - eye1 / BS;
+        int zd = (j * CHUNKD + CHUNKD2) - eye2 / BS;
+        return DIST_SQ(xd, yd, zd) * SECTIONS + s;
+}
+
+// draw the sections (x, y is the section, z) in order, all sections in a run from
+// the same arena with one call when we can, each one's chunk origin coming from
+// the draw's base instance
+void draw_sections(struct qitem *sections, size_t len, int *polys_drawn)
+{
+        if (!use_multi_draw)
+        {
+                for (size_t i = 0; i < len; i++)
+                {
+                        int x = sections[i].x;
+                        int s = sections[i].y;
+                        int z = sections[i].z;
+                        if (!VBOLEN_(x, s, z)) continue;
+                        glBindVertexArray(arenas[VBOARENA_(x, s, z)].vao);
+                        glVertexAttrib2f(4, x * CHUNKW, z * CHUNKD);
+                        glDrawArrays(GL_POINTS, VBOFIRST_(x, s, z), VBOLEN_(x, s, z));
+                        *polys_drawn += VBOLEN_(x, s, z);
+                }
+                return;
+        }
+
+        // glMultiDrawArraysIndirect() is 4.3, past Mac's gl3.h, where it's always the above
+        #ifdef GLEW_ARB_multi_draw_indirect
+        struct draw_cmd { GLuint count, instance_count, first, base_instance; };
+        static struct draw_cmd cmds[VAOS * SECTIONS];
+        static float origins[VAOS * SECTIONS][2];
+        static unsigned char cmd_arena[VAOS * SECTIONS];
+        size_t n = 0;
+
+        for (size_t i = 0; i < len; i++)
+        {
+                int x = sections[i].x;
+                int s = sections[i].y;
+                int z = sections[i].z;
+                if (!VBOLEN_(x, s, z)) continue;
+                cmds[n] = (struct draw_cmd){ VBOLEN_(x, s, z), 1, VBOFIRST_(x, s, z), n };
+                origins[n][0] = x * CHUNKW;
+                origins[n][1] = z * CHUNKD;
+                cmd_arena[n] = VBOARENA_(x, s, z);
+                *polys_drawn += VBOLEN_(x, s, z);
+                n++;
+        }
+
+        if (!n) return;
+
+        // orphan the old buffers, which the last pass may still be drawing from
+        glBindBuffer(GL_ARRAY_BUFFER, origin_vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof origins, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, n * sizeof *origins, origins);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_vbo);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof cmds, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, n * sizeof *cmds, cmds);
+
+        for (size_t i = 0, j; i < n; i = j)
+        {
+                for (j = i + 1; j < n && cmd_arena[j] == cmd_arena[i]; j++)
+                        ;
+                glBindVertexArray(arenas[cmd_arena[i]].vao);
+                glMultiDrawArraysIndirect(GL_POINTS, (void *)(i * sizeof *cmds), j - i, 0);
+        }
+        #endif
+}
+
+// send frame_uniforms over to the frame block of the main and shadow programs
+void upload_frame_uniforms()
+{
+        glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof frame_uniforms, &frame_uniforms);
+}
+
 //draw everything in the game on the screen
 void draw_stuff()
 {
-        float identityM[] = {
-                1, 0, 0, 0,
-                0, 1, 0, 0,
-                0, 0, 1, 0,
-                0, 0, 0, 1,
-        };
-        float shadow_space[16];
+        struct frame_uniforms *fu = &frame_uniforms;
+        fu->block_size = BS;
 
         glDisable(GL_MULTISAMPLE);
 
-        float modelM[16];
-        memcpy(modelM, identityM, sizeof identityM);
+        TIMER(upload)
+        static struct qitem shipped[VAOS * SECTIONS];
+        size_t shipped_len = upload_meshes(shipped);
+        TIMER(culling)
+        build_chunk_quadtree();
+        TIMER()
 
         // make shadow map
         if (shadow_mapping)
@@ -154,38 +206,23 @@ void draw_stuff()
                         0, 0, tz, 1,
                 };
 
-                float shadow_pvM[16];
+                static float shadow_pvM[16];
                 if (!lock_culling)
                         mat4_multiply(shadow_pvM, orthoM, viewM);
 
-                glUniformMatrix4fv(glGetUniformLocation(shadow_prog_id, "proj"), 1, GL_FALSE, orthoM);
-                glUniformMatrix4fv(glGetUniformLocation(shadow_prog_id, "view"), 1, GL_FALSE, viewM);
-                glUniform1i(glGetUniformLocation(shadow_prog_id, "tarray"), 0);
-                glUniform1f(glGetUniformLocation(shadow_prog_id, "BS"), BS);
-
                 float biasM[] = {
                         0.5,   0,   0, 1,
                           0, 0.5,   0, 1,
                           0,   0, 0.5, 1,
                         0.5, 0.5, 0.5, 1,
                 };
-                float tmpM[16];
-                mat4_multiply(tmpM, orthoM, viewM);
-                mat4_multiply(shadow_space, biasM, tmpM);
+                mat4_multiply(fu->shadow_pv, orthoM, viewM);
+                mat4_multiply(fu->shadow_space, biasM, fu->shadow_pv);
+                upload_frame_uniforms();
 
-                for (int i = 0; i < VAOW; i++) for (int j = 0; j < VAOD; j++)
-                {
-                        if (!VBOLEN_(i, j)) continue;
-                        if (!frustum_culling || chunk_in_frustum(shadow_pvM, i, j))
-                        {
-                                glBindVertexArray(VAO_(i, j));
-                                modelM[12] = i * BS * CHUNKW;
-                                modelM[14] = j * BS * CHUNKD;
-                                glUniformMatrix4fv(glGetUniformLocation(shadow_prog_id, "model"), 1, GL_FALSE, modelM);
-                                glDrawArrays(GL_POINTS, 0, VBOLEN_(i, j));
-                                shadow_polys += VBOLEN_(i, j);
-                        }
-                }
+                static struct qitem casters[VAOS * SECTIONS];
+                size_t casters_len = frustum_cull(shadow_pvM, casters, &shadow_sections_culled);
+                draw_sections(casters, casters_len, &shadow_polys);
 
                 fb_is_bad:
                 glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -273,300 +310,99 @@ void draw_stuff()
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D_ARRAY, material_tex_id);
-        glUniform1i(glGetUniformLocation(prog_id, "tarray"), 0);
-
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D, shadow_tex_id);
-        glUniform1i(glGetUniformLocation(prog_id, "shadow_map"), 1);
-        glUniform1i(glGetUniformLocation(prog_id, "shadow_mapping"), shadow_mapping);
 
-        glUniformMatrix4fv(glGetUniformLocation(prog_id, "proj"), 1, GL_FALSE, projM);
-        glUniformMatrix4fv(glGetUniformLocation(prog_id, "view"), 1, GL_FALSE, translated_viewM);
-        glUniformMatrix4fv(glGetUniformLocation(prog_id, "shadow_space"), 1, GL_FALSE, shadow_space);
-
-        glUniform1f(glGetUniformLocation(prog_id, "BS"), BS);
-
-        if (sun_pitch < PI)
-                glUniform3f(glGetUniformLocation(prog_id, "light_pos"), sun_pos.x, sun_pos.y, sun_pos.z);
-        else
-                glUniform3f(glGetUniformLocation(prog_id, "light_pos"), moon_pos.x, moon_pos.y, moon_pos.z);
-
-        glUniform3f(glGetUniformLocation(prog_id, "view_pos"), eye0, eye1, eye2);
+        mat4_multiply(fu->pv, projM, translated_viewM);
+        struct point *light = sun_pitch < PI ? &sun_pos : &moon_pos;
+        memcpy(fu->light_pos, (float[4]){ light->x, light->y, light->z, 1 }, sizeof fu->light_pos);
+        memcpy(fu->view_pos, (float[4]){ eye0, eye1, eye2, 1 }, sizeof fu->view_pos);
+        fu->shadow_mapping = shadow_mapping;
+        fu->water_frame = pframe / 10;
 
         {
                 float m = ICLAMP(night_amt * 2.f, 0.f, 1.f);
-                glUniform1f(glGetUniformLocation(prog_id, "sharpness"), m*m*m*(m*(m*6.f-15.f)+10.f));
+                fu->sharpness = m*m*m*(m*(m*6.f-15.f)+10.f);
 
                 float r = lerp(night_amt, DAY_R, NIGHT_R);
                 float g = lerp(night_amt, DAY_G, NIGHT_G);
                 float b = lerp(night_amt, DAY_B, NIGHT_B);
-                glUniform3f(glGetUniformLocation(prog_id, "day_color"), r, g, b);
-                glUniform3f(glGetUniformLocation(prog_id, "glo_color"), 0.92f, 0.83f, 0.69f);
-                glUniform3f(glGetUniformLocation(prog_id, "fog_color"), fog_r, fog_g, fog_b);
+                memcpy(fu->day_color, (float[4]){ r, g, b, 1 }, sizeof fu->day_color);
+                memcpy(fu->glo_color, (float[4]){ 0.92f, 0.83f, 0.69f, 1 }, sizeof fu->glo_color);
+                memcpy(fu->fog_color, (float[4]){ fog_r, fog_g, fog_b, 1 }, sizeof fu->fog_color);
         }
 
-        // determine which chunks to send to gl
-        TIMER(rings)
-        int x0 = (eye0 - BS * CHUNKW2) / (BS * CHUNKW);
-        int z0 = (eye2 - BS * CHUNKW2) / (BS * CHUNKD);
-        CLAMP(x0, 0, VAOW - 2);
-        CLAMP(z0, 0, VAOD - 2);
-        int x1 = x0 + 1;
-        int z1 = z0 + 1;
-
-        int x0d = ((x0 * BS * CHUNKW + BS * CHUNKW2) - eye0);
-        int x1d = ((x1 * BS * CHUNKW + BS * CHUNKW2) - eye0);
-        int z0d = ((z0 * BS * CHUNKD + BS * CHUNKD2) - eye2);
-        int z1d = ((z1 * BS * CHUNKD + BS * CHUNKD2) - eye2);
-
-        // initialize with ring0 chunks
-        struct qitem fresh[VAOW*VAOD] = { // chunkx, distance sq, chunkz
-                {x0, (x0d * x0d + z0d * z0d), z0},
-                {x0, (x0d * x0d + z1d * z1d), z1},
-                {x1, (x1d * x1d + z0d * z0d), z0},
-                {x1, (x1d * x1d + z1d * z1d), z1}
-        };
-        size_t fresh_len = 4;
-
-        qsort(fresh, fresh_len, sizeof(struct qitem), sorter);
+        upload_frame_uniforms();
 
+        // ask the mesh workers to remesh sections that changed, nearest first, and
+        // whole chunks that moved to another ring's level of detail
+        TIMER(meshrequests)
+        static struct qitem dirty[VAOS * SECTIONS]; // chunkx, section_key(), chunkz
+        size_t dirty_len = 0;
+        int eye_cx = eye0 / (BS * CHUNKW);
+        int eye_cz = eye2 / (BS * CHUNKD);
+        memset(chunks_at_lod, 0, sizeof chunks_at_lod);
         #pragma omp critical
+        for (int i = 0; i < VAOW; i++) for (int j = 0; j < VAOD; j++)
         {
-                memcpy(fresh + fresh_len,
-                                (struct qitem *)just_generated,
-                                just_gen_len * sizeof *just_generated);
-                fresh_len += just_gen_len;
-                just_gen_len = 0;
-        }
-
-        // position within each ring that we're at this frame
-	static struct qitem ringpos[VAOW + VAOD] = {0};
-        for (int r = 1; r < VAOW + VAOD; r++)
-        {
-		// expand ring in all directions
-		x0--; x1++; z0--; z1++;
-
-                // freshen farther rings less and less often
-                if (r >= 3 && r <= 6 && frame % 2 != r % 2)   continue;
-                if (r >= 7 && r <= 14 && frame % 4 != r % 4)  continue;
-                if (r >= 15 && r <= 30 && frame % 8 != r % 8) continue;
-                if (r >= 31 && frame % 16 != r % 16)          continue;
-
-                int *x = &ringpos[r].x;
-                int *z = &ringpos[r].z;
-
-                // move to next chunk, maybe on ring
-                --(*x);
-
-                // wrap around the ring
-		int x_too_low = (*x < x0);
-                if (x_too_low) { *x = x1; --(*z); }
-
-                // reset if out of the ring
-		int z_too_low = (*z < z0);
-                if (z_too_low) { *x = x1; *z = z1; }
+                if (!AGEN_(i, j)) continue; // don't bother with ungenerated chunks
 
-                // get out of the middle
-		int is_on_ring = (*z == z0 || *z == z1 || *x == x1);
-                if (!is_on_ring) { *x = x0; }
-
-                // render if in bounds
-                if (*x >= 0 && *x < VAOW && *z >= 0 && *z < VAOD)
+                int lod = pick_lod(LOD_(i, j), MAX(abs(i - eye_cx), abs(j - eye_cz)));
+                if (lod != LOD_(i, j))
                 {
-                        fresh[fresh_len].x = *x;
-                        fresh[fresh_len].z = *z;
-                        fresh_len++;
+                        LOD_(i, j) = lod;
+                        for (int s = 0; s < SECTIONS; s++)
+                                DIRTY_(i, s, j) = true;
                 }
-        }
-
-        // render non-fresh chunks
-        TIMER(drawstale)
-        struct qitem stale[VAOW * VAOD] = {0}; // chunkx, distance sq, chunkz
-        size_t stale_len = 0;
-        for (int i = 0; i < VAOW; i++) for (int j = 0; j < VAOD; j++)
-        {
-                // skip chunks we will draw fresh this frame
-                size_t limit = show_fresh_updates ? fresh_len : 4;
-                for (size_t k = 0; k < limit; k++)
-                        if (fresh[k].x == i && fresh[k].z == j)
-                                goto skip;
-
-                stale[stale_len].x = i;
-                stale[stale_len].z = j;
-                int xd = ((i * BS * CHUNKW + BS * CHUNKW2) - eye0);
-                int zd = ((j * BS * CHUNKD + BS * CHUNKD2) - eye2);
-                stale[stale_len].y = (xd * xd + zd * zd);
-
-                // only queue chunks we could see
-                if (chunk_in_frustum(pvM, i, j))
-                        stale_len++;
+                chunks_at_lod[lod]++;
 
-                skip: ;
-        }
+                for (int s = 0; s < SECTIONS; s++)
+                {
+                        if (!DIRTY_(i, s, j)) continue;
 
-        qsort(stale, stale_len, sizeof *stale, sorter);
-        for (size_t my = 0; my < stale_len; my++)
-        {
-                int myx = stale[my].x;
-                int myz = stale[my].z;
-                modelM[12] = myx * BS * CHUNKW;
-                modelM[14] = myz * BS * CHUNKD;
-                glUniformMatrix4fv(glGetUniformLocation(prog_id, "model"), 1, GL_FALSE, modelM);
-                glBindVertexArray(VAO_(myx, myz));
-                glDrawArrays(GL_POINTS, 0, VBOLEN_(myx, myz));
-                polys += VBOLEN_(myx, myz);
+                        DIRTY_(i, s, j) = false;
+                        dirty[dirty_len++] = (struct qitem){ i, section_key(i, s, j, eye0, eye1, eye2), j };
+                }
         }
-
-        // package, ship and render fresh chunks (while the stales are rendering!)
-        TIMER(buildvbo);
-        for (size_t my = 0; my < fresh_len; my++)
+        qsort(dirty, dirty_len, sizeof *dirty, nearest_sorter);
+        for (size_t k = 0; k < dirty_len; k++)
+                dirty[k].y %= SECTIONS;
+        request_meshes(dirty, dirty_len);
+
+        // only sections we could see
+        TIMER(culling)
+        static struct qitem stale[VAOS * SECTIONS]; // chunkx, section, chunkz
+        size_t stale_len = frustum_cull(pvM, stale, &sections_out_of_view);
+        sections_occluded = 0;
+        if (occlusion_culling)
+                stale_len = occlusion_cull(pvM, stale, stale_len, &sections_occluded);
+
+        // render sections, farthest first
+        TIMER(drawchunks)
+        size_t drawn_len = 0;
+        for (size_t k = 0; k < stale_len; k++)
         {
-                int myx = fresh[my].x;
-                int myz = fresh[my].z;
-                int xlo = myx * CHUNKW;
-                int xhi = xlo + CHUNKW;
-                int zlo = myz * CHUNKD;
-                int zhi = zlo + CHUNKD;
-                int ungenerated = false;
-
-                #pragma omp critical
-                if (!AGEN_(myx, myz))
-                {
-                        ungenerated = true;
-                }
+                int i = stale[k].x;
+                int s = stale[k].y;
+                int j = stale[k].z;
 
-                if (ungenerated)
-                        continue; // don't bother with ungenerated chunks
+                // skip sections that just got a new mesh, so they blink
+                if (show_fresh_updates)
+                        for (size_t n = 0; n < shipped_len; n++)
+                                if (shipped[n].x == i && shipped[n].y == s && shipped[n].z == j)
+                                        goto skip;
 
-                glBindVertexArray(VAO_(myx, myz));
-                glBindBuffer(GL_ARRAY_BUFFER, VBO_(myx, myz));
-                v = vbuf; // reset vertex buffer pointer
-                w = wbuf; // same for water buffer
-
-                TIMER(buildvbo);
-
-                for (int z = zlo; z < zhi; z++) for (int y = 0; y < TILESH; y++) for (int x = xlo; x < xhi; x++)
-                {
-                        if (v >= v_limit) break; // out of vertex space, shouldnt reasonably happen
-
-                        if (w >= w_limit) w -= 10; // just overwrite water if we run out of space
-
-                        if (T_(x, y, z) == OPEN && (!show_light_values || !in_test_area(x, y, z)))
-                                continue;
-
-                        //lighting
-                        float usw = CORN_(x  , y  , z  );
-                        float use = CORN_(x+1, y  , z  );
-                        float unw = CORN_(x  , y  , z+1);
-                        float une = CORN_(x+1, y  , z+1);
-                        float dsw = CORN_(x  , y+1, z  );
-                        float dse = CORN_(x+1, y+1, z  );
-                        float dnw = CORN_(x  , y+1, z+1);
-                        float dne = CORN_(x+1, y+1, z+1);
-                        float USW = KORN_(x  , y  , z  );
-                        float USE = KORN_(x+1, y  , z  );
-                        float UNW = KORN_(x  , y  , z+1);
-                        float UNE = KORN_(x+1, y  , z+1);
-                        float DSW = KORN_(x  , y+1, z  );
-                        float DSE = KORN_(x+1, y+1, z  );
-                        float DNW = KORN_(x  , y+1, z+1);
-                        float DNE = KORN_(x+1, y+1, z+1);
-                        int t = T_(x, y, z);
-                        int m = x & (CHUNKW-1);
-                        int n = z & (CHUNKD-1);
-
-                        if (t == GRAS)
-                        {
-                                if (y == 0        || T_(x  , y-1, z  ) >= OPEN) *v++ = (struct vbufv){ 0,    UP, m, y, n, usw, use, unw, une, USW, USE, UNW, UNE, 1 };
-                                if (z == 0        || T_(x  , y  , z-1) >= OPEN) *v++ = (struct vbufv){ 1, SOUTH, m, y, n, use, usw, dse, dsw, USE, USW, DSE, DSW, 1 };
-                                if (z == TILESD-1 || T_(x  , y  , z+1) >= OPEN) *v++ = (struct vbufv){ 1, NORTH, m, y, n, unw, une, dnw, dne, UNW, UNE, DNW, DNE, 1 };
-                                if (x == 0        || T_(x-1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ 1,  WEST, m, y, n, usw, unw, dsw, dnw, USW, UNW, DSW, DNW, 1 };
-                                if (x == TILESW-1 || T_(x+1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ 1,  EAST, m, y, n, une, use, dne, dse, UNE, USE, DNE, DSE, 1 };
-                                if (y <  TILESH-1 && T_(x  , y+1, z  ) >= OPEN) *v++ = (struct vbufv){ 2,  DOWN, m, y, n, dse, dsw, dne, dnw, DSE, DSW, DNE, DNW, 1 };
-                        }
-                        else if (t == DIRT || t == GRG1 || t == GRG2)
-                        {
-                                int u = (t == DIRT) ? 2 :
-                                        (t == GRG1) ? 3 : 4;
-                                if (y == 0        || T_(x  , y-1, z  ) >= OPEN) *v++ = (struct vbufv){ u,    UP, m, y, n, usw, use, unw, une, USW, USE, UNW, UNE, 1 };
-                                if (z == 0        || T_(x  , y  , z-1) >= OPEN) *v++ = (struct vbufv){ 2, SOUTH, m, y, n, use, usw, dse, dsw, USE, USW, DSE, DSW, 1 };
-                                if (z == TILESD-1 || T_(x  , y  , z+1) >= OPEN) *v++ = (struct vbufv){ 2, NORTH, m, y, n, unw, une, dnw, dne, UNW, UNE, DNW, DNE, 1 };
-                                if (x == 0        || T_(x-1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ 2,  WEST, m, y, n, usw, unw, dsw, dnw, USW, UNW, DSW, DNW, 1 };
-                                if (x == TILESW-1 || T_(x+1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ 2,  EAST, m, y, n, une, use, dne, dse, UNE, USE, DNE, DSE, 1 };
-                                if (y <  TILESH-1 && T_(x  , y+1, z  ) >= OPEN) *v++ = (struct vbufv){ 2,  DOWN, m, y, n, dse, dsw, dne, dnw, DSE, DSW, DNE, DNW, 1 };
-                        }
-                        else if (t == STON || t == SAND || t == ORE || t == OREH || t == HARD || t == WOOD || t == GRAN ||
-                                 t == RLEF || t == YLEF)
-                        {
-                                int f = (t == STON) ?  5 :
-                                        (t == SAND) ?  6 :
-                                        (t == ORE ) ? 11 :
-                                        (t == OREH) ? 12 :
-                                        (t == HARD) ? 13 :
-                                        (t == WOOD) ? 14 :
-                                        (t == GRAN) ? 15 :
-                                        (t == RLEF) ? 16 :
-                                        (t == YLEF) ? 17 :
-                                                       0 ;
-                                if (y == 0        || T_(x  , y-1, z  ) >= OPEN) *v++ = (struct vbufv){ f,    UP, m, y, n, usw, use, unw, une, USW, USE, UNW, UNE, 1 };
-                                if (z == 0        || T_(x  , y  , z-1) >= OPEN) *v++ = (struct vbufv){ f, SOUTH, m, y, n, use, usw, dse, dsw, USE, USW, DSE, DSW, 1 };
-                                if (z == TILESD-1 || T_(x  , y  , z+1) >= OPEN) *v++ = (struct vbufv){ f, NORTH, m, y, n, unw, une, dnw, dne, UNW, UNE, DNW, DNE, 1 };
-                                if (x == 0        || T_(x-1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ f,  WEST, m, y, n, usw, unw, dsw, dnw, USW, UNW, DSW, DNW, 1 };
-                                if (x == TILESW-1 || T_(x+1, y  , z  ) >= OPEN) *v++ = (struct vbufv){ f,  EAST, m, y, n, une, use, dne, dse, UNE, USE, DNE, DSE, 1 };
-                                if (y <  TILESH-1 && T_(x  , y+1, z  ) >= OPEN) *v++ = (struct vbufv){ f,  DOWN, m, y, n, dse, dsw, dne, dnw, DSE, DSW, DNE, DNW, 1 };
-                        }
-                        else if (t == WATR)
-                        {
-                                if (y == 0        || T_(x  , y-1, z  ) == OPEN)
-                                {
-                                        int f = 7 + (pframe / 10 + (x ^ z)) % 4;
-                                        *w++ = (struct vbufv){ f,    UP, m, y+0.06f, n, usw, use, unw, une, USW, USE, UNW, UNE, 0.5f };
-                                        *w++ = (struct vbufv){ f,  DOWN, m, y-0.94f, n, dse, dsw, dne, dnw, DSE, DSW, DNE, DNW, 0.5f };
-                                }
-                        }
-                        else if (t == LITE)
-                        {
-                                *w++ = (struct vbufv){ 18, SOUTH, m     , y, n+0.5f, use, usw, dse, dsw, 1.3f, 1.3f, 1.3f, 1.3f, 1 };
-                                *w++ = (struct vbufv){ 18, NORTH, m     , y, n-0.5f, unw, une, dnw, dne, 1.3f, 1.3f, 1.3f, 1.3f, 1 };
-                                *w++ = (struct vbufv){ 18,  WEST, m+0.5f, y, n     , usw, unw, dsw, dnw, 1.3f, 1.3f, 1.3f, 1.3f, 1 };
-                                *w++ = (struct vbufv){ 18,  EAST, m-0.5f, y, n     , une, use, dne, dse, 1.3f, 1.3f, 1.3f, 1.3f, 1 };
-                        }
-
-                        if (show_light_values && in_test_area(x, y, z))
-                        {
-                                int f = GLO_(x, y, z) + PNG0;
-                                int ty = y;
-                                float lit = 1.f;
-                                if (IS_OPAQUE(x, y, z))
-                                {
-                                        ty = y - 1;
-                                        lit = 0.1f;
-                                }
-                                *w++ = (struct vbufv){ f,    UP, m, ty+0.9f, n, lit, lit, lit, lit, lit, lit, lit, lit, 1.f };
-                                *w++ = (struct vbufv){ f,  DOWN, m, ty-0.1f, n, lit, lit, lit, lit, lit, lit, lit, lit, 1.f };
-                        }
-                }
+                stale[drawn_len++] = (struct qitem){ i, section_key(i, s, j, eye0, eye1, eye2), j };
 
-                if (w - wbuf < v_limit - v) // room for water in vertex buffer?
-                {
-                        memcpy(v, wbuf, (w - wbuf) * sizeof *wbuf);
-                        v += w - wbuf;
-                }
-
-                VBOLEN_(myx, myz) = v - vbuf;
-                polys += VBOLEN_(myx, myz);
-                TIMER(glBufferData)
-                glBufferData(GL_ARRAY_BUFFER, VBOLEN_(myx, myz) * sizeof *vbuf, vbuf, GL_STATIC_DRAW);
-                if (my < 4) // draw the newly buffered verts
-                {
-                        TIMER(glDrawArrays)
-                        modelM[12] = myx * BS * CHUNKW;
-                        modelM[13] = 0.f;
-                        modelM[14] = myz * BS * CHUNKD;
-                        glUniformMatrix4fv(glGetUniformLocation(prog_id, "model"), 1, GL_FALSE, modelM);
-                        glDrawArrays(GL_POINTS, 0, VBOLEN_(myx, myz));
-                }
+                skip: ;
         }
+        stale_len = drawn_len;
+        sections_drawn = stale_len;
+
+        qsort(stale, stale_len, sizeof *stale, sorter);
+        for (size_t k = 0; k < stale_len; k++)
+                stale[k].y %= SECTIONS;
+        draw_sections(stale, stale_len, &polys);
 
         debrief();
 
@@ -8,6 +8,7 @@
 
 GLuint font_tex_id;
 unsigned int font_prog_id;
+GLint font_uniforms[NR_UNIFORMS];
 GLuint font_vbo, font_vao;
 
 int font_screenw;
@@ -160,6 +161,7 @@ void font_init()
         glAttachShader(font_prog_id, fragment);
         glLinkProgram(font_prog_id);
         check_program_errors(font_prog_id, "font");
+        find_uniforms(font_prog_id, font_uniforms);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
@@ -256,11 +258,11 @@ void font_end(float r, float g, float b)
                 0, 0, z,  0,
                -1, 1, tz, 1,
         };
-        glUniformMatrix4fv(glGetUniformLocation(font_prog_id, "proj"), 1, GL_FALSE, ortho);
+        glUniformMatrix4fv(font_uniforms[U_proj], 1, GL_FALSE, ortho);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, font_tex_id);
-        glUniform1i(glGetUniformLocation(font_prog_id, "tex"), 2);
+        glUniform1i(font_uniforms[U_tex], 2);
 
         glBindVertexArray(font_vao);
         glBindBuffer(GL_ARRAY_BUFFER, font_vbo);
@@ -270,10 +272,10 @@ void font_end(float r, float g, float b)
         glEnableVertexAttribArray(0);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glUniform3f(glGetUniformLocation(font_prog_id, "incolor"), 0, 0, 0);
+        glUniform3f(font_uniforms[U_incolor], 0, 0, 0);
         glDrawArrays(GL_TRIANGLES, 0, n);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glUniform3f(glGetUniformLocation(font_prog_id, "incolor"), r, g, b);
+        glUniform3f(font_uniforms[U_incolor], r, g, b);
         glDrawArrays(GL_TRIANGLES, 0, n);
 }
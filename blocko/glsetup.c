@@ -63,10 +63,26 @@ unsigned int file2shader(unsigned int type, char *filename)
         return id;
 }
 
+// look up the uniforms of a freshly linked program, -1 for ones it doesn't have,
+// and hook it up to the frame block if it uses that
+void find_uniforms(GLuint prog, GLint *locs)
+{
+        for (int i = 0; i < NR_UNIFORMS; i++)
+                locs[i] = glGetUniformLocation(prog, uniform_names[i]);
+
+        GLuint block = glGetUniformBlockIndex(prog, "frame");
+        if (block != GL_INVALID_INDEX)
+                glUniformBlockBinding(prog, block, FRAME_BINDING);
+}
+
+// (re)build the main and shadow programs, can be called again to reload them
 void load_shaders()
 {
         printf("GLSL version on this system is %s\n", (char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
 
+        if (prog_id) glDeleteProgram(prog_id);
+        if (shadow_prog_id) glDeleteProgram(shadow_prog_id);
+
         unsigned int vertex          = file2shader(GL_VERTEX_SHADER,   "shaders/main.vert");
         unsigned int geometry        = file2shader(GL_GEOMETRY_SHADER, "shaders/main.geom");
         unsigned int fragment        = file2shader(GL_FRAGMENT_SHADER, "shaders/main.frag");
@@ -94,6 +110,16 @@ void load_shaders()
         glDeleteShader(shadow_vertex);
         glDeleteShader(shadow_geometry);
         glDeleteShader(shadow_fragment);
+
+        find_uniforms(prog_id, prog_uniforms);
+        find_uniforms(shadow_prog_id, shadow_prog_uniforms);
+
+        // samplers never change texture units, so set them once here
+        glUseProgram(prog_id);
+        glUniform1i(prog_uniforms[U_tarray], 0);
+        glUniform1i(prog_uniforms[U_shadow_map], 1);
+        glUseProgram(shadow_prog_id);
+        glUniform1i(shadow_prog_uniforms[U_tarray], 0);
 }
 
 #ifndef __APPLE__
@@ -206,36 +232,43 @@ void glsetup()
 
         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT); // greedy meshed faces
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT); // tile their texture
 
         load_shaders();
 
-        glGenVertexArrays(VAOS, vao);
-        glGenBuffers(VAOS, vbo);
-        for (int i = 0; i < VAOS; i++)
+        glGenBuffers(1, &frame_ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, frame_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof frame_uniforms, NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frame_ubo);
+
+        #ifdef GLEW_ARB_multi_draw_indirect
+        use_multi_draw = GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+        #endif
+        if (use_multi_draw)
         {
-                glBindVertexArray(vao[i]);
-                glBindBuffer(GL_ARRAY_BUFFER, vbo[i]);
-                // tex number
-                glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->tex);
-                glEnableVertexAttribArray(0);
-                // orientation
-                glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->orient);
-                glEnableVertexAttribArray(1);
-                // position
-                glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->x);
-                glEnableVertexAttribArray(2);
-                // illum
-                glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->illum0);
-                glEnableVertexAttribArray(3);
-                // glow
-                glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->glow0);
-                glEnableVertexAttribArray(4);
-                // alpha
-                glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->alpha);
-                glEnableVertexAttribArray(5);
+                glGenBuffers(1, &origin_vbo);
+                glGenBuffers(1, &indirect_vbo);
         }
+        printf("Drawing chunks %s\n", use_multi_draw ? "with glMultiDrawArraysIndirect" : "one at a time");
+
+        new_arena();
+
+        // staging ring for chunk uploads, mapped for good; Mac's gl3.h stops at 4.1,
+        // so there it's always glBufferSubData and upload.c never touches the ring
+        #ifdef GLEW_ARB_buffer_storage
+        use_buffer_storage = GLEW_ARB_buffer_storage;
+        if (use_buffer_storage)
+        {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glGenBuffers(1, &ring_vbo);
+                glBindBuffer(GL_COPY_READ_BUFFER, ring_vbo);
+                glBufferStorage(GL_COPY_READ_BUFFER, RING_SECTIONS * RING_SECTION_SZ, NULL, flags);
+                ring_map = glMapBufferRange(GL_COPY_READ_BUFFER, 0, RING_SECTIONS * RING_SECTION_SZ, flags);
+                if (!ring_map) use_buffer_storage = false;
+        }
+        #endif
+        printf("Uploading chunks %s\n", use_buffer_storage ? "through a persistent mapped ring" : "with glBufferSubData");
 
         // create shadow map texture
         glGenTextures(1, &shadow_tex_id);
@@ -259,3 +292,41 @@ void glsetup()
         glReadBuffer(GL_NONE);
         glBindFramebuffer(GL_FRAMEBUFFER, 0); // <- even need this?
 }
+
+// another arena for section meshes, returns false if there are already ARENAS
+int new_arena()
+{
+        if (nr_arenas == ARENAS)
+                return false;
+
+        struct arena *r = arenas + nr_arenas++;
+        glGenVertexArrays(1, &r->vao);
+        glGenBuffers(1, &r->vbo);
+        glBindVertexArray(r->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, r->vbo);
+        glBufferData(GL_ARRAY_BUFFER, ARENA_LEN * sizeof (struct vbufv), NULL, GL_STATIC_DRAW);
+        r->free[0] = (struct span){ 0, ARENA_LEN };
+        r->nr_free = 1;
+        // position
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->pos);
+        glEnableVertexAttribArray(0);
+        // tex number, orientation, size, alpha
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->info);
+        glEnableVertexAttribArray(1);
+        // illum
+        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->illum);
+        glEnableVertexAttribArray(2);
+        // glow
+        glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof (struct vbufv), (void*)&((struct vbufv *)NULL)->glow);
+        glEnableVertexAttribArray(3);
+        // chunk origin, per draw, or a glVertexAttrib2f() when drawing one at a time
+        if (use_multi_draw)
+        {
+                glBindBuffer(GL_ARRAY_BUFFER, origin_vbo);
+                glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+                glVertexAttribDivisor(4, 1);
+                glEnableVertexAttribArray(4);
+        }
+
+        return true;
+}
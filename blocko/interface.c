@@ -101,6 +101,7 @@ void key_move(int down)
                                 test_area_x = place_x - TEST_AREA_SZ / 2;
                                 test_area_y = place_y;
                                 test_area_z = place_z - TEST_AREA_SZ / 2;
+                                dirty_all_chunks(); // old test area too
                         }
                         break;
                 case SDLK_p: // speed of the sun
@@ -124,8 +125,28 @@ void key_move(int down)
                 case SDLK_F5: // delete test chunk
                         if (!down) for(int x=0;x<CHUNKW;x++) for(int y=0;y<TILESH;y++) for(int z=0;z<CHUNKD;z++)
                         {
-                                T_(C2B(32) + x, y, C2B(32) + z) = OPEN;
+                                SET_T_(C2B(32) + x, y, C2B(32) + z, OPEN);
                         }
+                        if (!down) dirty_tiles(C2B(32), C2B(32) + CHUNKW, C2B(32), C2B(32) + CHUNKD);
+                        break;
+                case SDLK_F6: // greedy meshing
+                        if (!down)
+                        {
+                                greedy_meshing = !greedy_meshing;
+                                dirty_all_chunks();
+                        }
+                        break;
+                case SDLK_F7: // reload shaders from disk
+                        if (!down) load_shaders();
+                        break;
+                case SDLK_F8: // do occlusion culling
+                        if (down) occlusion_culling = !occlusion_culling;
+                        break;
+                case SDLK_F9: // coarser meshes for far chunks
+                        if (down) lod_meshing = !lod_meshing;
+                        break;
+                case SDLK_F10: // time spent spreading light each frame
+                        if (down) light_budget_us = (light_budget_us >= 8000) ? 500 : light_budget_us * 2;
                         break;
                 case SDLK_F12: // draw shadow map on the sun
                         if (!down) show_shadow_map = !show_shadow_map;
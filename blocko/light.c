@@ -1,19 +1,141 @@
 #include "blocko.h"
 
-void sun_enqueue(int x, int y, int z, int base, unsigned char incoming_light)
+// swap *b from *old to new in one go, unless another thread got to it first, then
+// returning false with what it is now in *old
+int cas_byte(unsigned char *b, unsigned char *old, unsigned char new)
 {
-        if (incoming_light == 0)
-                return;
+#ifdef _MSC_VER
+        unsigned char seen = _InterlockedCompareExchange8((volatile char *)b, new, *old);
+        if (seen == *old)
+                return true;
+        *old = seen;
+        return false;
+#else
+        return __atomic_compare_exchange_n(b, old, new, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+}
+
+// set the sunlight (shift 4) or glow (shift 0) nibble of a lightmap byte, keeping
+// the other: chunk builders set sunlight while the main thread spreads glow, so the
+// byte goes straight from what it was to what it will be, never half written
+void set_light_nibble(unsigned char *b, int shift, int light)
+{
+        unsigned char old = *b;
+        while (!cas_byte(b, &old, (old & (0xf0 >> shift)) | light << shift))
+                ;
+}
+
+// the bitmaps of which blocks are waiting in q, false if out of memory
+int alloc_light_queue(struct light_queue *q)
+{
+        q->queued[0] = calloc(QUEUED_BYTES, 1);
+        q->queued[1] = calloc(QUEUED_BYTES, 1);
+        return q->queued[0] && q->queued[1];
+}
+
+// add x, y, z to q's next wave, unless it's already waiting in either wave, making
+// the wave bigger if need be, returns false if it can't
+int light_queue_push(struct light_queue *q, int x, int y, int z)
+{
+        size_t i = TILE_INDEX(x, y, z);
+        unsigned char bit = 1 << (i & 7);
+        unsigned char *curr = q->queued[q->gen & 1] + i / 8;
+        unsigned char *next = q->queued[~q->gen & 1] + i / 8;
+
+        if ((*curr | *next) & bit)
+                return true; // already queued
+
+        struct light_wave *w = q->wave + (~q->gen & 1);
+        if (w->len == w->room)
+        {
+                size_t room = w->room ? 2 * w->room : 4096;
+                struct qitem *items = realloc(w->items, room * sizeof *items);
+                if (!items)
+                        return false;
+                w->items = items;
+                w->room = room;
+        }
+
+        *next |= bit;
+        w->items[w->len++] = QITEM(x, y, z);
+        light_pending[B2C(z)][B2C(x)]++;
+        return true;
+}
+
+// make q's next wave the current one, carrying over whatever the current one didn't
+// get to spread from, returns how many blocks there wasn't room to carry over
+size_t light_queue_swap(struct light_queue *q)
+{
+        struct light_wave *w = q->wave + (q->gen & 1);
+        size_t lost = 0;
+
+        for (size_t i = q->next; i < w->len; i++)
+        {
+                light_queue_pop(q, w->items[i].x, w->items[i].y, w->items[i].z);
+                if (!light_queue_push(q, w->items[i].x, w->items[i].y, w->items[i].z))
+                        lost++;
+        }
+
+        w->len = 0;
+        q->next = 0;
+        q->gen++;
+        return lost;
+}
+
+// blocks waiting in q to spread their light, in either wave
+size_t light_queue_depth(struct light_queue *q)
+{
+        return q->wave[q->gen & 1].len - q->next + q->wave[~q->gen & 1].len;
+}
+
+// move the blocks within LIGHT_NEAR of ex, ez to the front of what's left of q's
+// current wave
+void light_queue_near_first(struct light_queue *q, int ex, int ez)
+{
+        struct light_wave *w = q->wave + (q->gen & 1);
+        size_t near = q->next;
+
+        for (size_t i = q->next; i < w->len; i++)
+        {
+                if (abs(w->items[i].x - ex) >= LIGHT_NEAR || abs(w->items[i].z - ez) >= LIGHT_NEAR)
+                        continue;
+
+                struct qitem tmp = w->items[near];
+                w->items[near++] = w->items[i];
+                w->items[i] = tmp;
+        }
+}
+
+// take the block at x, y, z out of the current wave's bitmap, as it's spread from
+void light_queue_pop(struct light_queue *q, int x, int y, int z)
+{
+        size_t i = TILE_INDEX(x, y, z);
+        q->queued[q->gen & 1][i / 8] &= ~(1 << (i & 7));
+        light_pending[B2C(z)][B2C(x)]--;
+}
 
+// how much of the light coming into x, y, z it lets through
+unsigned char filter_light(int x, int y, int z, unsigned char light)
+{
         if (T_(x, y, z) == WATR)
-                incoming_light--; // water blocks more light
+                light--; // water blocks more light
 
         if (T_(x, y, z) == RLEF || T_(x, y, z) == YLEF)
         {
-                incoming_light--; // leaves block more light
-                if (incoming_light) incoming_light--;
+                light--; // leaves block more light
+                if (light) light--;
         }
 
+        return light;
+}
+
+void sun_enqueue(int x, int y, int z, unsigned char incoming_light)
+{
+        if (incoming_light == 0)
+                return;
+
+        incoming_light = filter_light(x, y, z, incoming_light);
+
         if (SUN_(x, y, z) >= incoming_light)
                 return; // already brighter
 
@@ -22,39 +144,16 @@ void sun_enqueue(int x, int y, int z, int base, unsigned char incoming_light)
 
         set_sunlight(x, y, z, incoming_light);
 
-        if (sq_next_len >= SUNQLEN)
-        {
+        if (!light_queue_push(&sunq, x, y, z))
                 sunq_outta_room++;
-                return; // out of room in sun queue
-        }
-
-        for (size_t i = base; i < sq_curr_len; i++)
-                if (sunq_curr[i].x == x && sunq_curr[i].y == y && sunq_curr[i].z == z)
-                        return; // already queued in current queue
-
-        for (size_t i = 0; i < sq_next_len; i++)
-                if (sunq_next[i].x == x && sunq_next[i].y == y && sunq_next[i].z == z)
-                        return; // already queued in next queue
-
-        sunq_next[sq_next_len].x = x;
-        sunq_next[sq_next_len].y = y;
-        sunq_next[sq_next_len].z = z;
-        sq_next_len++;
 }
 
-void glo_enqueue(int x, int y, int z, int base, unsigned char incoming_light)
+void glo_enqueue(int x, int y, int z, unsigned char incoming_light)
 {
         if (incoming_light == 0)
                 return;
 
-        if (T_(x, y, z) == WATR)
-                incoming_light--; // water blocks more light
-
-        if (T_(x, y, z) == RLEF || T_(x, y, z) == YLEF)
-        {
-                incoming_light--; // leaves block more light
-                if (incoming_light) incoming_light--;
-        }
+        incoming_light = filter_light(x, y, z, incoming_light);
 
         if (GLO_(x, y, z) >= incoming_light)
                 return; // already brighter
@@ -64,284 +163,353 @@ void glo_enqueue(int x, int y, int z, int base, unsigned char incoming_light)
 
         set_glolight(x, y, z, incoming_light);
 
-        if (gq_next_len >= GLOQLEN)
-        {
+        if (!light_queue_push(&gloq, x, y, z))
                 gloq_outta_room++;
-                return; // out of room in glo queue
-        }
-
-        for (size_t i = base; i < gq_curr_len; i++)
-                if (gloq_curr[i].x == x && gloq_curr[i].y == y && gloq_curr[i].z == z)
-                        return; // already queued in current queue
-
-        for (size_t i = 0; i < gq_next_len; i++)
-                if (gloq_next[i].x == x && gloq_next[i].y == y && gloq_next[i].z == z)
-                        return; // already queued in next queue
-
-        gloq_next[gq_next_len].x = x;
-        gloq_next[gq_next_len].y = y;
-        gloq_next[gq_next_len].z = z;
-        gq_next_len++;
 }
 
-int step_sunlight()
+// gen_chunk() runs on the chunk builder threads, so it leaves sunlight to be
+// spread here instead of touching the sun queue, which is the main thread's
+void sun_seed(int x, int y, int z, unsigned char light)
 {
-        // swap the queues
-        sunq_curr = sunq_next;
-        sq_curr_len = sq_next_len;
-        sq_next_len = 0;
-        sunq_next = (sunq_curr == sunq0_) ? sunq1_ : sunq0_;
-
-        for (size_t i = 0; i < sq_curr_len; i++)
+        #pragma omp critical (sun_seeds)
         {
-                int x = sunq_curr[i].x;
-                int y = sunq_curr[i].y;
-                int z = sunq_curr[i].z;
-                char pass_on = SUN_(x, y, z);
-                if (pass_on) pass_on--; else continue;
-                if (x           ) sun_enqueue(x-1, y  , z  , i+1, pass_on);
-                if (x < TILESW-1) sun_enqueue(x+1, y  , z  , i+1, pass_on);
-                if (y           ) sun_enqueue(x  , y-1, z  , i+1, pass_on);
-                if (y < TILESH-1) sun_enqueue(x  , y+1, z  , i+1, pass_on);
-                if (z           ) sun_enqueue(x  , y  , z-1, i+1, pass_on);
-                if (z < TILESD-1) sun_enqueue(x  , y  , z+1, i+1, pass_on);
-        }
+                if (sun_seeds_len == sun_seeds_room)
+                {
+                        sun_seeds_room = sun_seeds_room ? 2 * sun_seeds_room : 4096;
+                        sun_seeds = realloc(sun_seeds, sun_seeds_room * sizeof *sun_seeds);
+                        if (!sun_seeds) exit(fprintf(stderr, "Out of memory for sun seeds\n"));
+                }
 
-        return sq_curr_len;
+                sun_seeds[sun_seeds_len++] = (struct qlight){x, y, z, light};
+                seeds_pending[B2C(z)][B2C(x)]++;
+        }
 }
 
-int step_glolight()
+// move up to n seeds into the sun queue, returns how many
+size_t take_sun_seeds(size_t n)
 {
-        // swap the queues
-        gloq_curr = gloq_next;
-        gq_curr_len = gq_next_len;
-        gq_next_len = 0;
-        gloq_next = (gloq_curr == gloq0_) ? gloq1_ : gloq0_;
+        size_t taken = 0;
 
-        for (size_t i = 0; i < gq_curr_len; i++)
+        #pragma omp critical (sun_seeds)
+        for (; taken < n && sun_seeds_len; taken++)
         {
-                int x = gloq_curr[i].x;
-                int y = gloq_curr[i].y;
-                int z = gloq_curr[i].z;
-                char pass_on = GLO_(x, y, z);
-                if (pass_on) pass_on--; else continue;
-                if (x           ) glo_enqueue(x-1, y  , z  , i+1, pass_on);
-                if (x < TILESW-1) glo_enqueue(x+1, y  , z  , i+1, pass_on);
-                if (y           ) glo_enqueue(x  , y-1, z  , i+1, pass_on);
-                if (y < TILESH-1) glo_enqueue(x  , y+1, z  , i+1, pass_on);
-                if (z           ) glo_enqueue(x  , y  , z-1, i+1, pass_on);
-                if (z < TILESD-1) glo_enqueue(x  , y  , z+1, i+1, pass_on);
+                struct qlight *s = sun_seeds + --sun_seeds_len;
+                seeds_pending[B2C(s->z)][B2C(s->x)]--;
+                SET_SUN_(s->x, s->y, s->z, 0);
+                sun_enqueue(s->x, s->y, s->z, s->light);
         }
 
-        return gq_curr_len;
+        return taken;
 }
 
-void recalc_corner_lighting(int xlo, int xhi, int zlo, int zhi)
+void spread_sunlight(int x, int y, int z)
 {
-        for (int x = xlo; x < xhi; x++) for (int z = zlo; z < zhi; z++) for (int y = 0; y < TILESH; y++)
-        {
-                int x_ = (x == 0) ? 0 : x - 1;
-                int y_ = (y == 0) ? 0 : y - 1;
-                int z_ = (z == 0) ? 0 : z - 1;
-
-                CORN_(x, y, z) = 0.008f * (
-                                SUN_(x_, y_, z_) + SUN_(x , y_, z_) + SUN_(x_, y , z_) + SUN_(x , y , z_) +
-                                SUN_(x_, y_, z ) + SUN_(x , y_, z ) + SUN_(x_, y , z ) + SUN_(x , y , z ));
-                KORN_(x, y, z) = 0.008f * (
-                                GLO_(x_, y_, z_) + GLO_(x , y_, z_) + GLO_(x_, y , z_) + GLO_(x , y , z_) +
-                                GLO_(x_, y_, z ) + GLO_(x , y_, z ) + GLO_(x_, y , z ) + GLO_(x , y , z ));
-        }
+        char pass_on = SUN_(x, y, z);
+        if (pass_on) pass_on--; else return;
+        if (x           ) sun_enqueue(x-1, y  , z  , pass_on);
+        if (x < TILESW-1) sun_enqueue(x+1, y  , z  , pass_on);
+        if (y           ) sun_enqueue(x  , y-1, z  , pass_on);
+        if (y < TILESH-1) sun_enqueue(x  , y+1, z  , pass_on);
+        if (z           ) sun_enqueue(x  , y  , z-1, pass_on);
+        if (z < TILESD-1) sun_enqueue(x  , y  , z+1, pass_on);
 }
 
-void set_sunlight(int xlo, int ylo, int zlo, int light)
+void spread_glolight(int x, int y, int z)
 {
-        SUN_(xlo, ylo, zlo) = light;
+        char pass_on = GLO_(x, y, z);
+        if (pass_on) pass_on--; else return;
+        if (x           ) glo_enqueue(x-1, y  , z  , pass_on);
+        if (x < TILESW-1) glo_enqueue(x+1, y  , z  , pass_on);
+        if (y           ) glo_enqueue(x  , y-1, z  , pass_on);
+        if (y < TILESH-1) glo_enqueue(x  , y+1, z  , pass_on);
+        if (z           ) glo_enqueue(x  , y  , z-1, pass_on);
+        if (z < TILESD-1) glo_enqueue(x  , y  , z+1, pass_on);
+}
 
-        for (int x = xlo; x < xlo + 2; x++) for (int z = zlo; z < zlo + 2; z++) for (int y = ylo; y < ylo + 2; y++)
-        {
-                int x_ = (x == 0) ? 0 : x - 1;
-                int y_ = (y == 0) ? 0 : y - 1;
-                int z_ = (z == 0) ? 0 : z - 1;
+// spread light from up to n blocks in q's current wave, returns how many
+int spread_wave(struct light_queue *q, void (*spread)(int x, int y, int z), size_t n)
+{
+        struct light_wave *w = q->wave + (q->gen & 1);
+        size_t end = MIN(w->len, q->next + n);
+        size_t start = q->next;
 
-                CORN_(x, y, z) = 0.008f * (
-                                SUN_(x_, y_, z_) + SUN_(x , y_, z_) + SUN_(x_, y , z_) + SUN_(x , y , z_) +
-                                SUN_(x_, y_, z ) + SUN_(x , y_, z ) + SUN_(x_, y , z ) + SUN_(x , y , z ));
+        for (; q->next < end; q->next++)
+        {
+                struct qitem *it = w->items + q->next;
+                light_queue_pop(q, it->x, it->y, it->z);
+                spread(it->x, it->y, it->z); // only ever adds to the next wave
         }
+
+        return end - start;
 }
 
-void set_glolight(int xlo, int ylo, int zlo, int light)
+// spread light from each block in the current wave to its neighbors, which make up
+// the next wave, returns how many blocks spread light
+int step_sunlight()
 {
-        GLO_(xlo, ylo, zlo) = light;
-
-        for (int x = xlo; x < xlo + 2; x++) for (int z = zlo; z < zlo + 2; z++) for (int y = ylo; y < ylo + 2; y++)
-        {
-                int x_ = (x == 0) ? 0 : x - 1;
-                int y_ = (y == 0) ? 0 : y - 1;
-                int z_ = (z == 0) ? 0 : z - 1;
+        take_sun_seeds(SIZE_MAX);
+        sunq_outta_room += light_queue_swap(&sunq);
+        return spread_wave(&sunq, spread_sunlight, SIZE_MAX);
+}
 
-                KORN_(x, y, z) = 0.008f * (
-                                GLO_(x_, y_, z_) + GLO_(x , y_, z_) + GLO_(x_, y , z_) + GLO_(x , y , z_) +
-                                GLO_(x_, y_, z ) + GLO_(x , y_, z ) + GLO_(x_, y , z ) + GLO_(x , y , z ));
-        }
+int step_glolight()
+{
+        gloq_outta_room += light_queue_swap(&gloq);
+        return spread_wave(&gloq, spread_glolight, SIZE_MAX);
 }
 
-// remove direct or indirect sunlight
-// before calling, set opacity, but not light value
-void remove_sunlight(int px, int py, int pz)
+// spread sunlight and glow by turns, a batch of blocks at a time, for as long as
+// budget_us allows, starting each wave with the blocks near ex, ez so changes by
+// the camera light up first, returns how many blocks spread light
+int step_light(int budget_us, int ex, int ez)
 {
-        // FIXME: remove when confident
-        static int recursions = 0;
-        if (++recursions > 1000000)
+        unsigned long long start = SDL_GetPerformanceCounter();
+        unsigned long long budget = SDL_GetPerformanceFrequency() * budget_us / 1000000;
+        struct light_queue *queues[] = { &sunq, &gloq };
+        void (*spreads[])(int x, int y, int z) = { spread_sunlight, spread_glolight };
+        int *outta_room[] = { &sunq_outta_room, &gloq_outta_room };
+        int spread = 0;
+
+        // blocks queued since last time go ahead of far ones left over from then
+        for (int i = 0; i < 2; i++) if (queues[i]->wave[~queues[i]->gen & 1].len)
         {
-                fprintf(stderr, "1 million remove_sunlight() recursions\n");
-                return;
+                *outta_room[i] += light_queue_swap(queues[i]);
+                light_queue_near_first(queues[i], ex, ez);
         }
 
-        int my_light = SUN_(px, py, pz);
-        int im_opaque = IS_OPAQUE(px, py, pz);
-
-        if (my_light < 1) return;
-
-        struct qitem check_list[6];
-        struct qitem recur_list[6];
-        int check_len = 0;
-        int recur_len = 0;
+        for (;;)
+        {
+                // seeds from new chunks get their turn too, a batch at a time
+                int busy = take_sun_seeds(LIGHT_BATCH);
 
-        // FIXME: remove this when gndheight is already correct
-        for (int y = 0; y < TILESH-1; y++)
-                if (IS_OPAQUE(px, y, pz))
+                for (int i = 0; i < 2; i++)
                 {
-                        GNDH_(px, pz) = y;
-                        break;
+                        struct light_queue *q = queues[i];
+
+                        if (q->next == q->wave[q->gen & 1].len)
+                        {
+                                if (!q->wave[~q->gen & 1].len)
+                                        continue; // all spread
+                                *outta_room[i] += light_queue_swap(q);
+                                light_queue_near_first(q, ex, ez);
+                        }
+
+                        spread += spread_wave(q, spreads[i], LIGHT_BATCH);
+                        busy = true;
                 }
 
-        // i am in direct sunlight, no need to remove light
-        if (ABOVE_GROUND(px, py, pz))
-                return;
+                if (!busy || SDL_GetPerformanceCounter() - start >= budget)
+                        return spread;
+        }
+}
 
-        int incoming_light = 0;
-        int future_light = 0;
+// light changing is what puts a chunk's light out of date on disk, wherever it
+// spread from, see save_chunks()
+void set_sunlight(int x, int y, int z, int light)
+{
+        SET_SUN_(x, y, z, light);
+        dirty_block(x, y, z);
+        chunk_unsaved[B2C(z)][B2C(x)] = true;
+}
 
-        // find valid neighbors to check
-        if (px > 0       ) check_list[check_len++] = QITEM(px-1, py  , pz  );
-        if (px < TILESW-1) check_list[check_len++] = QITEM(px+1, py  , pz  );
-        if (py > 0       ) check_list[check_len++] = QITEM(px  , py-1, pz  );
-        // never spread sunlight value 15 upward:
-        if (py < TILESH-1 && SUN_(px,py+1,pz) != 15) check_list[check_len++] = QITEM(px  , py+1, pz  );
-        if (pz > 0       ) check_list[check_len++] = QITEM(px  , py  , pz-1);
-        if (pz < TILESD-1) check_list[check_len++] = QITEM(px  , py  , pz+1);
+void set_glolight(int x, int y, int z, int light)
+{
+        SET_GLO_(x, y, z, light);
+        dirty_block(x, y, z);
+        chunk_unsaved[B2C(z)][B2C(x)] = true;
+}
 
-        for (int i = 0; i < check_len; i++)
-        {
-                int x = check_list[i].x;
-                int y = check_list[i].y;
-                int z = check_list[i].z;
+// the light at the corner where blocks x-1..x, y-1..y and z-1..z meet, from the
+// sums of their sunlight and glow, scaled so 15 all round is a bit under 1
+void corner_light(int x, int y, int z, float *sun, float *glo)
+{
+        int x_ = (x == 0) ? 0 : x - 1;
+        int y_ = (y == 0) ? 0 : y - 1;
+        int z_ = (z == 0) ? 0 : z - 1;
+        if (y == TILESH) y = TILESH - 1; // under the bottom of the world
+
+        unsigned char *sw = lightmap + TILE_INDEX(x_, y_, z_);
+        unsigned char *se = lightmap + TILE_INDEX(x , y_, z_);
+        unsigned char *nw = lightmap + TILE_INDEX(x_, y_, z );
+        unsigned char *ne = lightmap + TILE_INDEX(x , y_, z );
+        size_t dy = TILE_INDEX(x, y, z) - TILE_INDEX(x, y_, z); // from y_ to y, the same in every column
+
+        // both nibbles added up at once, sunlight spread out to bits 16 and up
+        #define SPREAD(b) (((b) & 15) | ((b) & 0xf0) << 12)
+        unsigned sum = SPREAD(sw[0]) + SPREAD(sw[dy]) + SPREAD(se[0]) + SPREAD(se[dy]) +
+                       SPREAD(nw[0]) + SPREAD(nw[dy]) + SPREAD(ne[0]) + SPREAD(ne[dy]);
+        #undef SPREAD
+
+        *sun = 0.008f * (sum >> 16);
+        *glo = 0.008f * (sum & 0xffff);
+}
 
-                // no need to update my opaque neighbors
-                if (IS_OPAQUE(x, y, z)) continue;
+// add x, y, z to the dark queue, *len long so far, making it bigger if need be
+void dark_queue_push(int x, int y, int z, unsigned char light, size_t *len)
+{
+        if (*len == dark_queue_room)
+        {
+                dark_queue_room = dark_queue_room ? 2 * dark_queue_room : 4096;
+                dark_queue = realloc(dark_queue, dark_queue_room * sizeof *dark_queue);
+                if (!dark_queue) exit(fprintf(stderr, "Out of memory for darkening light\n"));
+        }
 
-                // i am lit by a neighbor block as much or more than before
-                // so... there is no more light to remove in this branch
-                if (SUN_(x, y, z) > my_light && !im_opaque) return;
+        dark_queue[(*len)++] = (struct qlight){x, y, z, light};
+}
 
-                // i am [now] being lit by this neighbor
-                if (SUN_(x, y, z) == my_light && !im_opaque)
-                        incoming_light = MAX(incoming_light, SUN_(x, y, z) - 1);
+// darken x, y, z if the light it had could have come from a darkened neighbor
+// that had light, else queue it to light the darkened blocks back up
+void sun_darken(int x, int y, int z, unsigned char light, size_t *len)
+{
+        unsigned char sun = SUN_(x, y, z);
 
-                // keep track of brightest neighboring light for queueing later
-                if (SUN_(x, y, z) > future_light && !im_opaque)
-                        future_light = SUN_(x, y, z);
+        if (!sun || T_(x, y, z) < OPEN)
+                return;
 
-                // i could be the light source for this neighbor, need to recurse
-                if (SUN_(x, y, z) < my_light)
-                        recur_list[recur_len++] = QITEM(x, y, z);
+        // direct sunlight stays, as does light at least as bright from elsewhere,
+        // except under the ground, where light as bright as direct sunlight can
+        // only be left over from before the block over it was placed
+        if (ABOVE_GROUND(x, y, z) || (sun >= light && sun < filter_light(x, y, z, 15)))
+        {
+                if (!light_queue_push(&sunq, x, y, z))
+                        sunq_outta_room++;
+                return;
         }
 
-        if (incoming_light >= my_light)
-                fprintf(stderr, "INCOMING LIGHT > MY LIGHT when darkening\n");
+        dark_queue_push(x, y, z, sun, len);
+        set_sunlight(x, y, z, 0);
+}
 
-        set_sunlight(px, py, pz, incoming_light);
+void glo_darken(int x, int y, int z, unsigned char light, size_t *len)
+{
+        unsigned char glo = GLO_(x, y, z);
 
-        // re-lighting may be needed here
-        if (future_light)
-                sun_enqueue(px, py, pz, 0, future_light - 1);
+        if (!glo || T_(x, y, z) < OPEN)
+                return;
 
-        // i had no light to give anyway
-        if (my_light < 2) return;
+        if (T_(x, y, z) == LITE || glo >= light)
+        {
+                if (!light_queue_push(&gloq, x, y, z))
+                        gloq_outta_room++;
+                return;
+        }
 
-        for (int i = 0; i < recur_len; i++)
-                remove_sunlight(recur_list[i].x, recur_list[i].y, recur_list[i].z);
+        dark_queue_push(x, y, z, glo, len);
+        set_glolight(x, y, z, 0);
 }
 
-void remove_glolight(int px, int py, int pz)
+// remove the sunlight from x, y, z and from the blocks it lit, breadth first, then
+// leave the sun queue to light them back up from whatever else still reaches them
+// before calling, set opacity and gndheight, but not light value
+void remove_sunlight(int px, int py, int pz)
 {
-        // FIXME: remove when confident
-        static int recursions = 0;
-        if (++recursions > 1000000)
+        if (!SUN_(px, py, pz) || ABOVE_GROUND(px, py, pz))
+                return; // nothing to remove, or still in direct sunlight
+
+        size_t len = 0;
+        dark_queue_push(px, py, pz, SUN_(px, py, pz), &len);
+        set_sunlight(px, py, pz, 0);
+
+        for (size_t i = 0; i < len; i++)
         {
-                fprintf(stderr, "1 million remove_glolight() recursions\n");
-                return;
+                int x = dark_queue[i].x;
+                int y = dark_queue[i].y;
+                int z = dark_queue[i].z;
+                unsigned char light = dark_queue[i].light;
+                if (x           ) sun_darken(x-1, y  , z  , light, &len);
+                if (x < TILESW-1) sun_darken(x+1, y  , z  , light, &len);
+                if (y           ) sun_darken(x  , y-1, z  , light, &len);
+                if (y < TILESH-1) sun_darken(x  , y+1, z  , light, &len);
+                if (z           ) sun_darken(x  , y  , z-1, light, &len);
+                if (z < TILESD-1) sun_darken(x  , y  , z+1, light, &len);
         }
+}
 
-        int my_light = GLO_(px, py, pz);
-        int im_opaque = IS_OPAQUE(px, py, pz);
-
-        if (my_light < 1) return;
+void remove_glolight(int px, int py, int pz)
+{
+        if (!GLO_(px, py, pz) || T_(px, py, pz) == LITE)
+                return; // nothing to remove, or still a light
 
-        struct qitem check_list[6];
-        struct qitem recur_list[6];
-        int check_len = 0;
-        int recur_len = 0;
-        int incoming_light = 0;
-        int future_light = 0;
+        size_t len = 0;
+        dark_queue_push(px, py, pz, GLO_(px, py, pz), &len);
+        set_glolight(px, py, pz, 0);
 
-        // find valid neighbors to check
-        if (px > 0       ) check_list[check_len++] = QITEM(px-1, py  , pz  );
-        if (px < TILESW-1) check_list[check_len++] = QITEM(px+1, py  , pz  );
-        if (py > 0       ) check_list[check_len++] = QITEM(px  , py-1, pz  );
-        if (py < TILESH-1) check_list[check_len++] = QITEM(px  , py+1, pz  );
-        if (pz > 0       ) check_list[check_len++] = QITEM(px  , py  , pz-1);
-        if (pz < TILESD-1) check_list[check_len++] = QITEM(px  , py  , pz+1);
+        for (size_t i = 0; i < len; i++)
+        {
+                int x = dark_queue[i].x;
+                int y = dark_queue[i].y;
+                int z = dark_queue[i].z;
+                unsigned char light = dark_queue[i].light;
+                if (x           ) glo_darken(x-1, y  , z  , light, &len);
+                if (x < TILESW-1) glo_darken(x+1, y  , z  , light, &len);
+                if (y           ) glo_darken(x  , y-1, z  , light, &len);
+                if (y < TILESH-1) glo_darken(x  , y+1, z  , light, &len);
+                if (z           ) glo_darken(x  , y  , z-1, light, &len);
+                if (z < TILESD-1) glo_darken(x  , y  , z+1, light, &len);
+        }
+}
 
-        for (int i = 0; i < check_len; i++)
+// gndheight is the first opaque block in the column, everything above it is in
+// direct sunlight
+void recalc_gndheight(int x, int z)
+{
+        int y;
+        for (y = 0; y < TILESH-1; y++)
         {
-                int x = check_list[i].x;
-                int y = check_list[i].y;
-                int z = check_list[i].z;
+                if (IS_OPAQUE(x, y, z))
+                        break;
+        }
 
-                // no need to update my opaque neighbors
-                if (IS_OPAQUE(x, y, z)) continue;
+        GNDH_(x, z) = y;
+}
 
-                // i am lit by a neighbor block as much or more than before
-                // so... there is no more light to remove in this branch
-                if (GLO_(x, y, z) > my_light && !im_opaque) return;
+// fix up the light after x, y, z is made opaque
+void light_placed_block(int x, int y, int z)
+{
+        if (ABOVE_GROUND(x, y, z))
+                GNDH_(x, z) = y;
 
-                // i am [now] being lit by this neighbor
-                if (GLO_(x, y, z) == my_light && !im_opaque)
-                        incoming_light = MAX(incoming_light, GLO_(x, y, z) - 1);
+        remove_glolight(x, y, z);
+        remove_sunlight(x, y, z); // and the direct sunlight it now shades below
+}
 
-                // keep track of brightest neighboring light for queueing later
-                if (GLO_(x, y, z) > future_light && !im_opaque)
-                        future_light = GLO_(x, y, z);
+// fix up the light after x, y, z is opened up, broken is what was there
+void light_broken_block(int x, int y, int z, int broken)
+{
+        unsigned char max = 0;
 
-                // i could be the light source for this neighbor, need to recurse
-                if (GLO_(x, y, z) < my_light)
-                        recur_list[recur_len++] = QITEM(x, y, z);
+        if (broken == LITE)
+        {
+                remove_glolight(x, y, z);
+                return;
         }
 
-        if (incoming_light >= my_light)
-                fprintf(stderr, "GLO: INCOMING LIGHT > MY LIGHT when darkening\n");
-
-        set_glolight(px, py, pz, incoming_light);
+        // gndheight needs to change if we broke the ground
+        if (AT_GROUND(x, y, z))
+                recalc_gndheight(x, z);
 
-        // re-lighting may be needed here
-        if (future_light)
-                glo_enqueue(px, py, pz, 0, future_light - 1);
-
-        // i had no light to give anyway
-        if (my_light < 2) return;
+        if (ABOVE_GROUND(x, y, z))
+        {
+                for (int yy = y; ABOVE_GROUND(x, yy, z); yy++)
+                        sun_enqueue(x, yy, z, 15);
+        }
+        else
+        {
+                if (x > 0        && SUN_(x-1, y  , z  ) > max) max = SUN_(x-1, y  , z  );
+                if (x < TILESW-1 && SUN_(x+1, y  , z  ) > max) max = SUN_(x+1, y  , z  );
+                if (y > 0        && SUN_(x  , y-1, z  ) > max) max = SUN_(x  , y-1, z  );
+                if (y < TILESH-1 && SUN_(x  , y+1, z  ) > max) max = SUN_(x  , y+1, z  );
+                if (z > 0        && SUN_(x  , y  , z-1) > max) max = SUN_(x  , y  , z-1);
+                if (z < TILESD-1 && SUN_(x  , y  , z+1) > max) max = SUN_(x  , y  , z+1);
+                sun_enqueue(x, y, z, max ? max - 1 : 0);
+        }
 
-        for (int i = 0; i < recur_len; i++)
-                remove_glolight(recur_list[i].x, recur_list[i].y, recur_list[i].z);
+        max = 0;
+        if (x > 0        && GLO_(x-1, y  , z  ) > max) max = GLO_(x-1, y  , z  );
+        if (x < TILESW-1 && GLO_(x+1, y  , z  ) > max) max = GLO_(x+1, y  , z  );
+        if (y > 0        && GLO_(x  , y-1, z  ) > max) max = GLO_(x  , y-1, z  );
+        if (y < TILESH-1 && GLO_(x  , y+1, z  ) > max) max = GLO_(x  , y+1, z  );
+        if (z > 0        && GLO_(x  , y  , z-1) > max) max = GLO_(x  , y  , z-1);
+        if (z < TILESD-1 && GLO_(x  , y  , z+1) > max) max = GLO_(x  , y  , z+1);
+        glo_enqueue(x, y, z, max ? max - 1 : 0);
 }
-
@@ -0,0 +1,338 @@
+#include "blocko.h"
+
+// far away chunks are meshed coarser: at level lod each cell of 1 << lod blocks on
+// a side is drawn as one block, solid if most of its blocks are, and at the last
+// level each 8x8 patch of columns is just a slab at their average ground height
+
+// which way each orientation faces, like face_defs in mesh.c
+int lod_dirs[7][3] = {
+        [UP]    = { 0, -1,  0 },
+        [EAST]  = { 1,  0,  0 },
+        [NORTH] = { 0,  0,  1 },
+        [WEST]  = {-1,  0,  0 },
+        [SOUTH] = { 0,  0, -1 },
+        [DOWN]  = { 0,  1,  0 },
+};
+
+#define LOD_POINT(tex, orient, m, y, n, width, height) pack_point(tex, orient, m, y, n, \
+                il[0], il[1], il[2], il[3], gl[0], gl[1], gl[2], gl[3], 1, width, height)
+
+enum { CELL_OPEN, CELL_SOLID, CELL_WATER };
+
+struct lod_cell { int kind, type, top_type; };
+
+// a tally of tile types, up to a few different ones
+struct vote { int n, type[8], count[8]; };
+
+void vote(struct vote *v, int type)
+{
+        for (int i = 0; i < v->n; i++)
+                if (v->type[i] == type)
+                {
+                        v->count[i]++;
+                        return;
+                }
+
+        if (v->n < 8)
+        {
+                v->type[v->n] = type;
+                v->count[v->n++] = 1;
+        }
+}
+
+// the type with the most votes, the first one voted for on a tie, or -1
+int vote_winner(struct vote *v)
+{
+        int best = -1, most = 0;
+        for (int i = 0; i < v->n; i++)
+                if (v->count[i] > most)
+                {
+                        best = v->type[i];
+                        most = v->count[i];
+                }
+        return best;
+}
+
+// the level of detail a chunk ring chunks out from the camera's gets, though it
+// stays at cur if that's right for a ring either side, so walking back and forth
+// over the edge of a ring doesn't keep remeshing it
+int lod_for_ring(int ring)
+{
+        int lod = 0;
+        while (lod + 1 < LODS && ring >= lod_rings[lod + 1])
+                lod++;
+        return lod;
+}
+
+int pick_lod(int cur, int ring)
+{
+        if (!lod_meshing)
+                return 0;
+
+        if (cur == lod_for_ring(MAX(ring - 1, 0)) || cur == lod_for_ring(ring + 1))
+                return cur;
+
+        return lod_for_ring(ring);
+}
+
+// what the k-block cell at x0, y0, z0 is drawn as, and its most common solid tile
+// type, and the most common among its blocks with nothing solid on top
+// open past the edges of the world and solid under the bottom, like solid_face()
+struct lod_cell lod_cell(int x0, int y0, int z0, int k)
+{
+        struct lod_cell c = { CELL_OPEN, -1, -1 };
+
+        if (x0 < 0 || x0 >= TILESW || z0 < 0 || z0 >= TILESD || y0 < 0)
+                return c;
+
+        if (y0 >= TILESH)
+        {
+                c.kind = CELL_SOLID;
+                return c;
+        }
+
+        struct vote all = { 0 }, tops = { 0 };
+        int solid = 0, water = 0;
+
+        for (int y = y0; y < y0 + k; y++) for (int z = z0; z < z0 + k; z++) for (int x = x0; x < x0 + k; x++)
+        {
+                int t = T_(x, y, z);
+                if (t == WATR)
+                {
+                        water++;
+                }
+                else if (solid_tex(t, UP) >= 0)
+                {
+                        solid++;
+                        vote(&all, t);
+                        if (y == 0 || solid_tex(T_(x, y - 1, z), UP) < 0)
+                                vote(&tops, t);
+                }
+        }
+
+        if (2 * solid >= k * k * k)
+                c.kind = CELL_SOLID;
+        else if (2 * (solid + water) >= k * k * k)
+                c.kind = CELL_WATER;
+
+        c.type = vote_winner(&all);
+        c.top_type = vote_winner(&tops);
+        if (c.top_type < 0) c.top_type = c.type;
+        return c;
+}
+
+// whether every block across the face of the k-block cell at x0, y0, z0 facing
+// orient covers it, so a neighbor at full detail has nothing to see through
+int lod_slab_covered(int x0, int y0, int z0, int k, int orient)
+{
+        int *d = lod_dirs[orient];
+        int x1 = d[0] ? (d[0] > 0 ? x0 + k : x0 - 1) : x0;
+        int z1 = d[2] ? (d[2] > 0 ? z0 + k : z0 - 1) : z0;
+        int wide_x = d[0] ? 1 : k;
+        int wide_z = d[2] ? 1 : k;
+
+        if (x1 < 0 || x1 >= TILESW || z1 < 0 || z1 >= TILESD)
+                return false;
+
+        for (int y = y0; y < y0 + k; y++) for (int z = z1; z < z1 + wide_z; z++) for (int x = x1; x < x1 + wide_x; x++)
+                if (T_(x, y, z) >= OPEN)
+                        return false;
+
+        return true;
+}
+
+// flat light for a face whose first block out is x, y, z going orient: that of
+// the first block that isn't opaque, looking up to reach blocks out
+void lod_face_light(int x, int y, int z, int orient, int reach, float *illum, float *glow)
+{
+        int *d = lod_dirs[orient];
+        float sun = 15.f, glo = 0.f; // above the world, or past its edges
+
+        for (int i = 0; i < reach; i++, x += d[0], y += d[1], z += d[2])
+        {
+                if (y < 0 || y >= TILESH || x < 0 || x >= TILESW || z < 0 || z >= TILESD)
+                        break;
+
+                sun = SUN_(x, y, z);
+                glo = GLO_(x, y, z);
+                if (!IS_OPAQUE(x, y, z))
+                        break;
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+                illum[c] = 0.008f * 8 * sun; // as corner_light() would have it with 8 blocks this lit
+                glow[c] = 0.008f * 8 * glo;
+        }
+}
+
+// faces of the cells of the section at xlo, ylo, zlo that show, each drawn from the
+// block on the cell's far side in that direction, since the geometry shader puts
+// east, north and down faces a block past their point
+// faces across the edge of the chunk are kept unless the full detail blocks
+// there cover them too, so that nearer, finer chunks never see a gap past their
+// edge where this chunk's surface is higher than its cells make out
+void mesh_lod_cells(int xlo, int ylo, int zlo, int k)
+{
+        #define N (SECTH / 2 + 2) // cells across at k = 2, with one more on each side
+        struct lod_cell cells[N][N][N];
+        int n = SECTH / k;
+        float il[4], gl[4];
+
+        for (int c = 0; c < n + 2; c++) for (int b = 0; b < n + 2; b++) for (int a = 0; a < n + 2; a++)
+                cells[c][b][a] = lod_cell(xlo + (a - 1) * k, ylo + (b - 1) * k, zlo + (c - 1) * k, k);
+
+        for (int c = 1; c <= n; c++) for (int b = 1; b <= n; b++) for (int a = 1; a <= n; a++)
+        {
+                struct lod_cell *cell = &cells[c][b][a];
+                int x0 = xlo + (a - 1) * k;
+                int y0 = ylo + (b - 1) * k;
+                int z0 = zlo + (c - 1) * k;
+                int m = x0 & (CHUNKW-1);
+                int nn = z0 & (CHUNKD-1);
+
+                if (v >= v_limit) return; // out of vertex space, shouldnt reasonably happen
+                if (w >= w_limit) w -= 10;
+
+                if (cell->kind == CELL_WATER)
+                {
+                        if (cells[c][b - 1][a].kind == CELL_OPEN)
+                        {
+                                lod_face_light(x0 + k / 2, y0 - 1, z0 + k / 2, UP, k, il, gl);
+                                int f = 7 + (x0 ^ z0) % 4;
+                                *w++ = pack_point(f, UP, m, y0 + 0.06f, nn, il[0], il[1], il[2], il[3],
+                                                gl[0], gl[1], gl[2], gl[3], 0.5f, k, k);
+                        }
+                        continue;
+                }
+
+                if (cell->kind != CELL_SOLID)
+                        continue;
+
+                for (int orient = UP; orient <= DOWN; orient++)
+                {
+                        int *d = lod_dirs[orient];
+                        struct lod_cell *next = &cells[c + d[2]][b + d[1]][a + d[0]];
+                        int across = (d[0] && (a + d[0] < 1 || a + d[0] > n)) || (d[2] && (c + d[2] < 1 || c + d[2] > n));
+
+                        if (next->kind == CELL_SOLID && !(across && !lod_slab_covered(x0, y0, z0, k, orient)))
+                                continue;
+
+                        int tex = solid_tex(orient == UP ? cell->top_type : cell->type, orient);
+                        if (tex < 0)
+                                continue;
+
+                        lod_face_light(d[0] ? (d[0] > 0 ? x0 + k : x0 - 1) : x0 + k / 2,
+                                       d[1] ? (d[1] > 0 ? y0 + k : y0 - 1) : y0 + k / 2,
+                                       d[2] ? (d[2] > 0 ? z0 + k : z0 - 1) : z0 + k / 2,
+                                       orient, k, il, gl);
+                        *v++ = LOD_POINT(tex, orient,
+                                        m + (orient == EAST ? k - 1 : 0),
+                                        y0 + (orient == DOWN ? k - 1 : 0),
+                                        nn + (orient == NORTH ? k - 1 : 0),
+                                        k, k);
+                }
+        }
+        #undef N
+}
+
+// average ground height of the k x k columns from x0, z0 and their most common
+// top tile, or -1 if they're off the world or not generated yet
+int lod_ground(int x0, int z0, int k, int *type)
+{
+        if (x0 < 0 || x0 >= TILESW || z0 < 0 || z0 >= TILESD || !AGEN_(x0 / CHUNKW, z0 / CHUNKD))
+                return -1;
+
+        struct vote tops = { 0 };
+        int sum = 0;
+
+        for (int z = z0; z < z0 + k; z++) for (int x = x0; x < x0 + k; x++)
+        {
+                int y = MIN(GNDH_(x, z), TILESH - 1);
+                int t = T_(x, y, z);
+                sum += y;
+                if (t == WATR || solid_tex(t, UP) >= 0)
+                        vote(&tops, t);
+        }
+
+        *type = vote_winner(&tops);
+        return (sum + k * k / 2) / (k * k);
+}
+
+// the part of the heightmap from ylo down to ylo + SECTH: the tops of the k x k
+// patches of the chunk at xlo, zlo, and walls down to lower patches next to them
+// walls on the edge of the chunk hang down at least LOD_SKIRT blocks, to hide
+// cracks against finer neighbors whose surface is a little lower
+void mesh_lod_heightmap(int xlo, int ylo, int zlo, int k)
+{
+        float il[4], gl[4];
+
+        for (int pz = zlo; pz < zlo + CHUNKD; pz += k) for (int px = xlo; px < xlo + CHUNKW; px += k)
+        {
+                int type;
+                int h = lod_ground(px, pz, k, &type);
+                if (h < 0 || type < 0)
+                        continue;
+
+                int m = px & (CHUNKW-1);
+                int n = pz & (CHUNKD-1);
+
+                if (v >= v_limit) return; // out of vertex space, shouldnt reasonably happen
+
+                if (h >= ylo && h < ylo + SECTH)
+                {
+                        lod_face_light(px + k / 2, h - 1, pz + k / 2, UP, k, il, gl);
+                        if (type == WATR)
+                                *v++ = pack_point(7 + (px ^ pz) % 4, UP, m, h + 0.06f, n, il[0], il[1], il[2], il[3],
+                                                gl[0], gl[1], gl[2], gl[3], 1.f, k, k);
+                        else
+                                *v++ = LOD_POINT(solid_tex(type, UP), UP, m, h, n, k, k);
+                }
+
+                for (int orient = EAST; orient <= SOUTH; orient++) // the sides
+                {
+                        int *d = lod_dirs[orient];
+                        int qx = px + d[0] * k;
+                        int qz = pz + d[2] * k;
+                        int across = qx < xlo || qx >= xlo + CHUNKW || qz < zlo || qz >= zlo + CHUNKD;
+
+                        int next_type;
+                        int bottom = lod_ground(qx, qz, k, &next_type);
+                        if (bottom < 0) continue;
+                        if (across) bottom = MAX(bottom, h + LOD_SKIRT);
+
+                        int top = MAX(h, ylo);
+                        bottom = MIN(bottom, ylo + SECTH);
+                        if (top >= bottom) continue;
+
+                        int tex = solid_tex(type, orient);
+                        if (tex < 0) tex = solid_tex(STON, orient);
+                        lod_face_light(d[0] > 0 ? px + k : d[0] < 0 ? px - 1 : px + k / 2, top,
+                                       d[2] > 0 ? pz + k : d[2] < 0 ? pz - 1 : pz + k / 2,
+                                       orient, k, il, gl);
+                        *v++ = LOD_POINT(tex, orient,
+                                        m + (orient == EAST ? k - 1 : 0), top, n + (orient == NORTH ? k - 1 : 0),
+                                        k, bottom - top);
+                }
+        }
+}
+
+// build the points for the section at xlo, ylo, zlo at level of detail lod into
+// vbuf, returns the number of points
+size_t mesh_lod_section(int xlo, int ylo, int zlo, int lod)
+{
+        reset_mesh_buffers();
+
+        if (lod == LODS - 1)
+                mesh_lod_heightmap(xlo, ylo, zlo, 1 << lod);
+        else
+                mesh_lod_cells(xlo, ylo, zlo, 1 << lod);
+
+        if (w - wbuf < v_limit - v) // room for water in vertex buffer?
+        {
+                memcpy(v, wbuf, (w - wbuf) * sizeof *wbuf);
+                v += w - wbuf;
+        }
+
+        return v - vbuf;
+}
@@ -10,14 +10,20 @@
 
 #include "atmosphere.c"
 #include "collision.c"
+#include "cull.c"
 #include "draw.c"
 #include "font.c"
 #include "glsetup.c"
 #include "interface.c"
 #include "light.c"
+#include "lod.c"
+#include "mesh.c"
 #include "player.c"
 #include "test.c"
 #include "terrain.c"
+#include "save.c"
+#include "tiles.c"
+#include "upload.c"
 
 //prototypes
 void startup();
@@ -31,12 +37,16 @@ int WinMain()
 int main()
 #endif
 {
-        omp_set_nested(1); // needed or omp won't parallelize chunk gen
         startup();
 
-        #pragma omp parallel sections
+        // one main thread, a few mesh chunks, the rest build chunks
+        mesh_workers = MAX(1, MIN(omp_get_num_procs(), TILE_READERS) / 4);
+        chunk_workers = MAX(1, omp_get_num_procs() - 1 - mesh_workers);
+        chunk_workers = MIN(chunk_workers, TILE_READERS - 1 - mesh_workers); // a slot each
+
+        #pragma omp parallel num_threads(1 + chunk_workers + mesh_workers)
         {
-                #pragma omp section
+                if (omp_get_thread_num() == 0)
                 { // main thread
                         TIMECALL(glsetup, ());
                         TIMECALL(font_init, ());
@@ -44,10 +54,12 @@ int main()
                         new_game();
                         main_loop();
                 }
-
-                #pragma omp section
-                { // worker thread, chunk builder
-                        create_hmap();
+                else if (omp_get_thread_num() > chunk_workers)
+                { // mesh workers
+                        mesh_builder();
+                }
+                else
+                { // worker threads, chunk builders
                         chunk_builder();
                 }
         }
@@ -59,7 +71,7 @@ void main_loop()
 
         while (SDL_PollEvent(&event)) switch (event.type)
         {
-                case SDL_QUIT:            exit(0);
+                case SDL_QUIT:            save_all_chunks(); exit(0);
                 case SDL_KEYDOWN:         key_move(1);       break;
                 case SDL_KEYUP:           key_move(0);       break;
                 case SDL_MOUSEMOTION:     mouse_move();      break;
@@ -100,9 +112,11 @@ void main_loop()
                 TIMECALL(update_player, (&camplayer, 0));
         }
 
+        notice_player_chunk();
         lerp_camera(accumulated_elapsed / interval, &player[0], &camplayer);
-        TIMECALL(step_sunlight, ());
-        TIMECALL(step_glolight, ());
+        TIMECALL(step_light, (light_budget_us, camplayer.pos.x / BS, camplayer.pos.z / BS));
+        TIMECALL(compact_tiles, (TILE_COMPACT_CHUNKS));
+        TIMECALL(save_chunks, (SAVE_CHUNKS));
         draw_stuff();
         frame++;
 } }
@@ -111,16 +125,21 @@ void startup()
 {
         open_simplex_noise(world_seed, &osn_context);
 
-        tiles = calloc(TILESD * TILESH * TILESW, sizeof *tiles);
-        sunlight = calloc(TILESD * TILESH * TILESW, sizeof *sunlight);
-        glolight = calloc(TILESD * TILESH * TILESW, sizeof *glolight);
-        cornlight = calloc((TILESD+1) * (TILESH+1) * (TILESW+1), sizeof *cornlight);
-        kornlight = calloc((TILESD+1) * (TILESH+1) * (TILESW+1), sizeof *kornlight);
+        alloc_tiles();
+        lightmap = calloc(TILESD * TILESH * TILESW, sizeof *lightmap);
+        alloc_light_queue(&sunq);
+        alloc_light_queue(&gloq);
+
+        chunk_queue_lock = SDL_CreateMutex();
+        chunk_queue_changed = SDL_CreateCond();
+        mesh_queue_lock = SDL_CreateMutex();
+        mesh_queue_changed = SDL_CreateCond();
+        region_lock = SDL_CreateMutex();
 }
 
 void new_game()
 {
-        while(just_gen_len < 1)
+        while(nr_chunks_generated < 1)
                 ; // wait for worker thread build first chunk
 
         printf("1st chunk generated, ready to start game\n");
@@ -139,8 +158,8 @@ void update_world()
 
                 for (y = 1; y < TILESH - 1; y++) {
                         if (0) ;
-                        else if (T_(x, y, z) == GRG1) T_(x, y, z) = GRG2;
-                        else if (T_(x, y, z) == GRG2) T_(x, y, z) = GRAS;
+                        else if (T_(x, y, z) == GRG1) { SET_T_(x, y, z, GRG2); dirty_block(x, y, z); }
+                        else if (T_(x, y, z) == GRG2) { SET_T_(x, y, z, GRAS); dirty_block(x, y, z); }
                         else if (T_(x, y, z) == DIRT) {
                                 if (T_(x  , y-1, z  ) == OPEN && (
                                     (T_(x  , y  , z+1) | 1) == GRAS ||
@@ -155,7 +174,8 @@ void update_world()
                                     (T_(x  , y-1, z-1) | 1) == GRAS ||
                                     (T_(x+1, y-1, z  ) | 1) == GRAS ||
                                     (T_(x-1, y-1, z  ) | 1) == GRAS) ) {
-                                        T_(x, y, z) = GRG1;
+                                        SET_T_(x, y, z, GRG1);
+                                        dirty_block(x, y, z);
                                 }
                                 break;
                         }
@@ -173,18 +193,6 @@ void move_to_ground(float *inout, int x, int y, int z)
         *inout = GNDH_(x, z) * BS - PLYR_H - 1;
 }
 
-void recalc_gndheight(int x, int z)
-{
-        int y;
-        for (y = 0; y < TILESH-1; y++)
-        {
-                if (T_(x, y, z) != OPEN)
-                        break;
-        }
-
-        GNDH_(x, z) = y;
-}
-
 // select block from eye following vector f
 void rayshot(float eye0, float eye1, float eye2, float f0, float f1, float f2)
 {
@@ -239,6 +247,8 @@ void scoot(int cx, int cz)
                 future_scootx += cx;
                 future_scootz += cz;
         }
+
+        wake_chunk_builders();
 }
 
 void apply_scoot()
@@ -0,0 +1,487 @@
+#include "blocko.h"
+
+// for each orientation, the neighbor that hides the face, and the face's corners
+// in the order the geometry shader takes them, as offsets for corner_light()
+struct face_def { int dx, dy, dz; int corner[4][3]; } face_defs[7] = {
+        [UP]    = { 0, -1,  0, {{0, 0, 0}, {1, 0, 0}, {0, 0, 1}, {1, 0, 1}} },
+        [EAST]  = { 1,  0,  0, {{1, 0, 1}, {1, 0, 0}, {1, 1, 1}, {1, 1, 0}} },
+        [NORTH] = { 0,  0,  1, {{0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}} },
+        [WEST]  = {-1,  0,  0, {{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1}} },
+        [SOUTH] = { 0,  0, -1, {{1, 0, 0}, {0, 0, 0}, {1, 1, 0}, {0, 1, 0}} },
+        [DOWN]  = { 0,  1,  0, {{1, 1, 0}, {0, 1, 0}, {1, 1, 1}, {0, 1, 1}} },
+};
+
+// order faces of a block go into the vertex buffer
+int face_order[6] = { UP, SOUTH, NORTH, WEST, EAST, DOWN };
+
+// texture for one face of a solid tile, -1 if not drawn this way
+int solid_tex(int t, int orient)
+{
+        switch (t)
+        {
+                case GRAS: return orient == UP ? 0 : orient == DOWN ? 2 : 1;
+                case DIRT: return 2;
+                case GRG1: return orient == UP ? 3 : 2;
+                case GRG2: return orient == UP ? 4 : 2;
+                case STON: return 5;
+                case SAND: return 6;
+                case ORE : return 11;
+                case OREH: return 12;
+                case HARD: return 13;
+                case WOOD: return 14;
+                case GRAN: return 15;
+                case RLEF: return 16;
+                case YLEF: return 17;
+        }
+
+        return -1;
+}
+
+// the face of the tile at x, y, z facing orient, if it can be seen
+// returns its texture and fills in its corner lighting, or returns -1
+int solid_face(int x, int y, int z, int orient, float *illum, float *glow)
+{
+        int tex = solid_tex(T_(x, y, z), orient);
+        if (tex < 0)
+                return -1;
+
+        struct face_def *f = face_defs + orient;
+        int nx = x + f->dx;
+        int ny = y + f->dy;
+        int nz = z + f->dz;
+
+        if (ny >= TILESH)
+                return -1; // no bottoms on the bottom of the world
+
+        if (nx >= 0 && nx < TILESW && ny >= 0 && nz >= 0 && nz < TILESD && T_(nx, ny, nz) < OPEN)
+                return -1; // covered
+
+        for (int i = 0; i < 4; i++)
+        {
+                int *c = f->corner[i];
+                corner_light(x + c[0], y + c[1], z + c[2], illum + i, glow + i);
+        }
+
+        return tex;
+}
+
+// pack one point into a vbufv, position rounded to 16ths of a block, lighting
+// to 125ths and alpha to 255ths
+struct vbufv pack_point(int tex, int orient, float x, float y, float z,
+                float il0, float il1, float il2, float il3, float gl0, float gl1, float gl2, float gl3,
+                float alpha, int width, int height)
+{
+        #define POS(a) ((unsigned)MAX((a) * 16.f + 16.5f, 0.f))
+        #define LIT(a) ((unsigned char)MIN((a) * 125.f + 0.5f, 255.f))
+        return (struct vbufv){
+                POS(x) | POS(z) << 9 | POS(y) << 18,
+                tex | orient << 8 | (width - 1) << 11 | (height - 1) << 15 | (unsigned)(alpha * 255.f + 0.5f) << 23,
+                { LIT(il0), LIT(il1), LIT(il2), LIT(il3) },
+                { LIT(gl0), LIT(gl1), LIT(gl2), LIT(gl3) },
+        };
+        #undef POS
+        #undef LIT
+}
+
+#define SOLID_POINT(tex, orient, m, y, n, il, gl, width, height) pack_point(tex, orient, m, y, n, \
+                il[0], il[1], il[2], il[3], gl[0], gl[1], gl[2], gl[3], 1, width, height)
+
+// solid faces one per visible block face
+void mesh_solid_faces(int xlo, int ylo, int zlo)
+{
+        float il[4], gl[4];
+
+        for (int z = zlo; z < zlo + CHUNKD; z++) for (int y = ylo; y < ylo + SECTH; y++) for (int x = xlo; x < xlo + CHUNKW; x++)
+        {
+                if (v >= v_limit) return; // out of vertex space, shouldnt reasonably happen
+
+                for (int i = 0; i < 6; i++)
+                {
+                        int tex = solid_face(x, y, z, face_order[i], il, gl);
+                        if (tex >= 0)
+                                *v++ = SOLID_POINT(tex, face_order[i], x & (CHUNKW-1), y, z & (CHUNKD-1), il, gl, 1, 1);
+                }
+        }
+}
+
+// a face the greedy mesher may merge with its neighbors
+struct greedy_cell { int tex; float illum[4], glow[4]; };
+
+// whether q can join p's rectangle going across (a-b) or down (a-c): same texture
+// and lighting, and p's lighting doesn't change in that direction, so the merged
+// rectangle shades exactly like the faces it replaces
+int merges(struct greedy_cell *p, struct greedy_cell *q, int across)
+{
+        int i = across ? 1 : 2; // corner opposite a in that direction
+        int j = across ? 2 : 1; // the other pair starts here
+
+        return p->tex == q->tex &&
+                p->illum[0] == p->illum[i] && p->illum[j] == p->illum[i+j] &&
+                p->glow[0]  == p->glow[i]  && p->glow[j]  == p->glow[i+j]  &&
+                !memcmp(p->illum, q->illum, sizeof p->illum) &&
+                !memcmp(p->glow, q->glow, sizeof p->glow);
+}
+
+// solid faces merged into rectangles of the same texture and lighting, so a sunny
+// 16x16 plateau goes from 256 points to 1
+// each slice of the section across orient is a grid of wide by high cells, a along
+// the face's a-b edge and b along its a-c edge
+void mesh_greedy_faces(int xlo, int ylo, int zlo)
+{
+        struct greedy_cell grid[MAX(SECTH, CHUNKD)][MAX(CHUNKW, CHUNKD)]; // per thread
+
+        for (int i = 0; i < 6; i++)
+        {
+                int orient = face_order[i];
+                int flat = (orient == UP || orient == DOWN);
+                int along_x = (orient != EAST && orient != WEST);
+                int slices = flat ? SECTH : along_x ? CHUNKD : CHUNKW;
+                int wide = along_x ? CHUNKW : CHUNKD;
+                int high = flat ? CHUNKD : SECTH;
+
+                for (int s = 0; s < slices; s++)
+                {
+                        for (int b = 0; b < high; b++) for (int a = 0; a < wide; a++)
+                        {
+                                int x = xlo + (along_x ? a : s);
+                                int y = ylo + (flat ? s : b);
+                                int z = zlo + (flat ? b : along_x ? s : a);
+                                struct greedy_cell *c = &grid[b][a];
+                                c->tex = solid_face(x, y, z, orient, c->illum, c->glow);
+                        }
+
+                        // grow a rectangle from each cell left, first across then down
+                        for (int b = 0; b < high; b++) for (int a = 0; a < wide; a++)
+                        {
+                                struct greedy_cell c = grid[b][a];
+                                if (c.tex < 0)
+                                        continue;
+
+                                int w = 1;
+                                while (a + w < wide && merges(&c, &grid[b][a + w], true))
+                                        w++;
+
+                                int h = 1;
+                                for (; b + h < high; h++)
+                                {
+                                        int k = 0;
+                                        while (k < w && merges(&c, &grid[b + h][a + k], false))
+                                                k++;
+                                        if (k < w)
+                                                break;
+                                }
+
+                                for (int j = 0; j < h; j++) for (int k = 0; k < w; k++)
+                                        grid[b + j][a + k].tex = -1;
+
+                                if (v >= v_limit) return; // out of vertex space, shouldnt reasonably happen
+                                *v++ = SOLID_POINT(c.tex, orient, along_x ? a : s, ylo + (flat ? s : b), flat ? b : along_x ? s : a,
+                                                c.illum, c.glow, w, h);
+                        }
+                }
+        }
+}
+
+// mark the meshes that show any of the blocks from xlo, ylo, zlo up to xhi, yhi, zhi
+// out of date, neighbors too, since meshes look a block past their section for
+// faces and light
+void dirty_blocks(int xlo, int xhi, int ylo, int yhi, int zlo, int zhi)
+{
+        for (int cx = MAX(xlo - 1, 0) / CHUNKW; cx <= MIN(xhi, TILESW - 1) / CHUNKW; cx++)
+                for (int cz = MAX(zlo - 1, 0) / CHUNKD; cz <= MIN(zhi, TILESD - 1) / CHUNKD; cz++)
+                        for (int s = MAX(ylo - 1, 0) / SECTH; s <= MIN(yhi, TILESH - 1) / SECTH; s++)
+                                DIRTY_(cx, s, cz) = true;
+}
+
+void dirty_block(int x, int y, int z)
+{
+        dirty_blocks(x, x + 1, y, y + 1, z, z + 1);
+}
+
+// whole columns, top to bottom
+void dirty_tiles(int xlo, int xhi, int zlo, int zhi)
+{
+        dirty_blocks(xlo, xhi, 0, TILESH, zlo, zhi);
+}
+
+// for changes to how everything is meshed
+void dirty_all_chunks()
+{
+        for (int i = 0; i < VAOS * SECTIONS; i++)
+                chunk_dirty[i] = true;
+}
+
+// whether every tile in the section at xlo, ylo, zlo is open
+int section_empty(int xlo, int ylo, int zlo)
+{
+        for (int z = zlo; z < zlo + CHUNKD; z++) for (int y = ylo; y < ylo + SECTH; y++) for (int x = xlo; x < xlo + CHUNKW; x++)
+                if (T_(x, y, z) != OPEN)
+                        return false;
+        return true;
+}
+
+// whether every tile in the section at xlo, ylo, zlo is opaque
+int section_full(int xlo, int ylo, int zlo)
+{
+        for (int z = zlo; z < zlo + CHUNKD; z++) for (int y = ylo; y < ylo + SECTH; y++) for (int x = xlo; x < xlo + CHUNKW; x++)
+                if (!IS_OPAQUE(x, y, z))
+                        return false;
+        return true;
+}
+
+// whether the blocks just outside the section at xlo, ylo, zlo cover all its outer
+// faces, checked the way solid_face() does
+int section_buried(int xlo, int ylo, int zlo)
+{
+        if (xlo == 0 || zlo == 0 || ylo == 0 || xlo + CHUNKW >= TILESW || zlo + CHUNKD >= TILESD)
+                return false; // faces on the edge of the world show
+
+        int below = ylo + SECTH; // nothing under the bottom of the world
+
+        for (int y = ylo; y < ylo + SECTH; y++)
+        {
+                for (int z = zlo; z < zlo + CHUNKD; z++)
+                        if (T_(xlo - 1, y, z) >= OPEN || T_(xlo + CHUNKW, y, z) >= OPEN)
+                                return false;
+                for (int x = xlo; x < xlo + CHUNKW; x++)
+                        if (T_(x, y, zlo - 1) >= OPEN || T_(x, y, zlo + CHUNKD) >= OPEN)
+                                return false;
+        }
+
+        for (int z = zlo; z < zlo + CHUNKD; z++) for (int x = xlo; x < xlo + CHUNKW; x++)
+                if (T_(x, ylo - 1, z) >= OPEN || (below < TILESH && T_(x, below, z) >= OPEN))
+                        return false;
+
+        return true;
+}
+
+// empty this thread's vertex and water buffers, making them first if need be
+void reset_mesh_buffers()
+{
+        if (!vbuf) // first mesh on this thread
+        {
+                vbuf = malloc((VERTEX_BUFLEN + 1000) * sizeof *vbuf); // + padding
+                wbuf = malloc((VERTEX_BUFLEN + 1000) * sizeof *wbuf);
+                if (!vbuf || !wbuf) exit(fprintf(stderr, "Out of memory for meshes\n"));
+                v_limit = vbuf + VERTEX_BUFLEN;
+                w_limit = wbuf + VERTEX_BUFLEN;
+        }
+
+        v = vbuf; // reset vertex buffer pointer
+        w = wbuf; // same for water buffer
+}
+
+// build the points for the section at xlo, ylo, zlo into vbuf, solid faces first and
+// then see-through ones (water, lights), returns the number of points
+// sections that are all air, or solid all the way through and buried, are skipped
+size_t mesh_section(int xlo, int ylo, int zlo)
+{
+        reset_mesh_buffers();
+
+        if (!show_light_values && (section_empty(xlo, ylo, zlo) ||
+                                (section_full(xlo, ylo, zlo) && section_buried(xlo, ylo, zlo))))
+                return 0;
+
+        if (greedy_meshing)
+                mesh_greedy_faces(xlo, ylo, zlo);
+        else
+                mesh_solid_faces(xlo, ylo, zlo);
+
+        for (int z = zlo; z < zlo + CHUNKD; z++) for (int y = ylo; y < ylo + SECTH; y++) for (int x = xlo; x < xlo + CHUNKW; x++)
+        {
+                if (w >= w_limit) w -= 10; // just overwrite water if we run out of space
+
+                int t = T_(x, y, z);
+                int m = x & (CHUNKW-1);
+                int n = z & (CHUNKD-1);
+
+                if (t == WATR)
+                {
+                        if (y == 0 || T_(x, y-1, z) == OPEN)
+                        {
+                                float usw, use, unw, une, dsw, dse, dnw, dne; // sunlight
+                                float USW, USE, UNW, UNE, DSW, DSE, DNW, DNE; // glow
+                                corner_light(x  , y  , z  , &usw, &USW);
+                                corner_light(x+1, y  , z  , &use, &USE);
+                                corner_light(x  , y  , z+1, &unw, &UNW);
+                                corner_light(x+1, y  , z+1, &une, &UNE);
+                                corner_light(x  , y+1, z  , &dsw, &DSW);
+                                corner_light(x+1, y+1, z  , &dse, &DSE);
+                                corner_light(x  , y+1, z+1, &dnw, &DNW);
+                                corner_light(x+1, y+1, z+1, &dne, &DNE);
+                                int f = 7 + (x ^ z) % 4; // main.vert animates this
+                                *w++ = pack_point(f,    UP, m, y+0.06f, n, usw, use, unw, une, USW, USE, UNW, UNE, 0.5f, 1, 1);
+                                *w++ = pack_point(f,  DOWN, m, y-0.94f, n, dse, dsw, dne, dnw, DSE, DSW, DNE, DNW, 0.5f, 1, 1);
+                        }
+                }
+                else if (t == LITE)
+                {
+                        float usw, use, unw, une, dsw, dse, dnw, dne, glo; // it glows anyway
+                        corner_light(x  , y  , z  , &usw, &glo);
+                        corner_light(x+1, y  , z  , &use, &glo);
+                        corner_light(x  , y  , z+1, &unw, &glo);
+                        corner_light(x+1, y  , z+1, &une, &glo);
+                        corner_light(x  , y+1, z  , &dsw, &glo);
+                        corner_light(x+1, y+1, z  , &dse, &glo);
+                        corner_light(x  , y+1, z+1, &dnw, &glo);
+                        corner_light(x+1, y+1, z+1, &dne, &glo);
+                        *w++ = pack_point(18, SOUTH, m     , y, n+0.5f, use, usw, dse, dsw, 1.3f, 1.3f, 1.3f, 1.3f, 1, 1, 1);
+                        *w++ = pack_point(18, NORTH, m     , y, n-0.5f, unw, une, dnw, dne, 1.3f, 1.3f, 1.3f, 1.3f, 1, 1, 1);
+                        *w++ = pack_point(18,  WEST, m+0.5f, y, n     , usw, unw, dsw, dnw, 1.3f, 1.3f, 1.3f, 1.3f, 1, 1, 1);
+                        *w++ = pack_point(18,  EAST, m-0.5f, y, n     , une, use, dne, dse, 1.3f, 1.3f, 1.3f, 1.3f, 1, 1, 1);
+                }
+
+                if (show_light_values && in_test_area(x, y, z))
+                {
+                        int f = GLO_(x, y, z) + PNG0;
+                        int ty = y;
+                        float lit = 1.f;
+                        if (IS_OPAQUE(x, y, z))
+                        {
+                                ty = y - 1;
+                                lit = 0.1f;
+                        }
+                        *w++ = pack_point(f,    UP, m, ty+0.9f, n, lit, lit, lit, lit, lit, lit, lit, lit, 1.f, 1, 1);
+                        *w++ = pack_point(f,  DOWN, m, ty-0.1f, n, lit, lit, lit, lit, lit, lit, lit, lit, 1.f, 1, 1);
+                }
+        }
+
+        if (w - wbuf < v_limit - v) // room for water in vertex buffer?
+        {
+                memcpy(v, wbuf, (w - wbuf) * sizeof *wbuf);
+                v += w - wbuf;
+        }
+
+        return v - vbuf;
+}
+
+// how far up and down the len points in vbuf go, and whether the section at xlo,
+// ylo, zlo is opaque all the way through, for culling
+struct section_bounds find_section_bounds(int xlo, int ylo, int zlo, size_t len)
+{
+        struct section_bounds b = { len ? TILESH : 0, 0, section_full(xlo, ylo, zlo) };
+
+        for (size_t i = 0; i < len; i++)
+        {
+                int y16 = (int)(vbuf[i].pos >> 18 & 4095) - 16; // 16ths of a block
+                int orient = vbuf[i].info >> 8 & 7;
+                int height = (vbuf[i].info >> 15 & 255) + 1;
+                int tall = (orient == UP || orient == DOWN) ? 1 : height; // faces go down from y
+                b.ylo = MIN(b.ylo, MAX(y16, 0) / 16);
+                b.yhi = MAX(b.yhi, MIN((y16 + 16 * tall + 15) / 16, 255));
+        }
+
+        return b;
+}
+
+// queue sections (x, y is the section, z) for the mesh workers, skipping any
+// already waiting
+void request_meshes(struct qitem *sections, size_t len)
+{
+        SDL_LockMutex(mesh_queue_lock);
+        for (size_t i = 0; i < len; i++)
+        {
+                int x = sections[i].x;
+                int sy = sections[i].y;
+                int z = sections[i].z;
+                int slot = SECT_(x, sy, z);
+                if (mesh_job_queued[slot]) continue;
+
+                mesh_job_queued[slot] = true;
+                mesh_jobs[(mesh_jobs_head + mesh_jobs_len++) % (VAOS * SECTIONS)] =
+                        (struct mesh_job){ x, sy, z, chunk_scootx, chunk_scootz, slot, ++mesh_job_gen[slot] };
+        }
+        SDL_CondBroadcast(mesh_queue_changed);
+        SDL_UnlockMutex(mesh_queue_lock);
+}
+
+// all the finished meshes, oldest first, for the caller to free
+struct chunk_mesh *take_ready_meshes()
+{
+        SDL_LockMutex(mesh_queue_lock);
+        struct chunk_mesh *m = ready_meshes;
+        ready_meshes = ready_meshes_tail = NULL;
+        SDL_UnlockMutex(mesh_queue_lock);
+        return m;
+}
+
+// put meshes that couldn't be uploaded this frame back at the front of the line
+void return_ready_meshes(struct chunk_mesh *m)
+{
+        if (!m) return;
+
+        struct chunk_mesh *tail = m;
+        while (tail->next) tail = tail->next;
+
+        SDL_LockMutex(mesh_queue_lock);
+        tail->next = ready_meshes;
+        ready_meshes = m;
+        if (!ready_meshes_tail) ready_meshes_tail = tail;
+        SDL_UnlockMutex(mesh_queue_lock);
+}
+
+// mesh the next queued section into its own buffer and put it on the ready list,
+// if wait then sleeping until there is one
+// returns false if there was nothing to mesh
+int build_mesh(int wait)
+{
+        struct mesh_job job;
+
+        SDL_LockMutex(mesh_queue_lock);
+        while (!mesh_jobs_len && wait)
+                SDL_CondWait(mesh_queue_changed, mesh_queue_lock);
+        int have_job = mesh_jobs_len > 0;
+        if (have_job)
+        {
+                job = mesh_jobs[mesh_jobs_head];
+                mesh_jobs_head = (mesh_jobs_head + 1) % (VAOS * SECTIONS);
+                mesh_jobs_len--;
+                mesh_job_queued[job.slot] = false;
+        }
+        SDL_UnlockMutex(mesh_queue_lock);
+
+        if (!have_job)
+                return false;
+
+        // if the map moves before we're done, the section is somewhere else now and
+        // some of the mesh came from the wrong place, so leave it for next time
+        if (job.scootx != chunk_scootx || job.scootz != chunk_scootz)
+        {
+                chunk_dirty[job.slot] = true;
+                return true;
+        }
+
+        int xlo = job.x * CHUNKW, ylo = job.sy * SECTH, zlo = job.z * CHUNKD;
+        int lod = LOD_(job.x, job.z);
+        begin_tile_reads();
+        size_t len = lod ? mesh_lod_section(xlo, ylo, zlo, lod) : mesh_section(xlo, ylo, zlo);
+        struct section_bounds bounds = find_section_bounds(xlo, ylo, zlo, len);
+        end_tile_reads();
+
+        if (job.scootx != chunk_scootx || job.scootz != chunk_scootz)
+        {
+                chunk_dirty[job.slot] = true;
+                return true;
+        }
+
+        struct chunk_mesh *m = malloc(sizeof *m + len * sizeof *vbuf);
+        if (!m) exit(fprintf(stderr, "Out of memory for meshes\n"));
+        *m = (struct chunk_mesh){ NULL, job.x, job.sy, job.z, job.scootx, job.scootz, job.slot, job.gen, len, bounds };
+        memcpy(m->verts, vbuf, len * sizeof *vbuf);
+
+        SDL_LockMutex(mesh_queue_lock);
+        if (ready_meshes_tail)
+                ready_meshes_tail->next = m;
+        else
+                ready_meshes = m;
+        ready_meshes_tail = m;
+        SDL_UnlockMutex(mesh_queue_lock);
+
+        return true;
+}
+
+// mesh worker thread main
+void mesh_builder()
+{
+        for (;;) build_mesh(true);
+}
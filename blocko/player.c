@@ -114,74 +114,30 @@ void update_player(struct player *p, int real)
                 int x = target_x;
                 int y = target_y;
                 int z = target_z;
-                unsigned char max = 0;
                 int broken = T_(x, y, z);
-                T_(x, y, z) = OPEN;
-
-                if (broken == LITE)
-                {
-                        remove_glolight(x, y, z);
-                        goto out;
-                }
-
-                // gndheight needs to change if we broke the ground
-                if (AT_GROUND(x, y, z))
-                        recalc_gndheight(x, z);
-
-                if (ABOVE_GROUND(x, y, z))
-                {
-                        while (y <= TILESH-1)
-                        {
-                                sun_enqueue(x, y, z, 0, 15);
-                                y++;
-                                if (!ABOVE_GROUND(x, y, z)) break;
-                        }
-                }
-                else
-                {
-                        if (x > 0        && SUN_(x-1, y  , z  ) > max) max = SUN_(x-1, y  , z  );
-                        if (x < TILESW-1 && SUN_(x+1, y  , z  ) > max) max = SUN_(x+1, y  , z  );
-                        if (y > 0        && SUN_(x  , y-1, z  ) > max) max = SUN_(x  , y-1, z  );
-                        if (y < TILESH-1 && SUN_(x  , y+1, z  ) > max) max = SUN_(x  , y+1, z  );
-                        if (z > 0        && SUN_(x  , y  , z-1) > max) max = SUN_(x  , y  , z-1);
-                        if (z < TILESD-1 && SUN_(x  , y  , z+1) > max) max = SUN_(x  , y  , z+1);
-                        sun_enqueue(x, y, z, 0, max ? max - 1 : 0);
-                }
-
-                max = 0;
-                if (x > 0        && GLO_(x-1, y  , z  ) > max) max = GLO_(x-1, y  , z  );
-                if (x < TILESW-1 && GLO_(x+1, y  , z  ) > max) max = GLO_(x+1, y  , z  );
-                if (y > 0        && GLO_(x  , y-1, z  ) > max) max = GLO_(x  , y-1, z  );
-                if (y < TILESH-1 && GLO_(x  , y+1, z  ) > max) max = GLO_(x  , y+1, z  );
-                if (z > 0        && GLO_(x  , y  , z-1) > max) max = GLO_(x  , y  , z-1);
-                if (z < TILESD-1 && GLO_(x  , y  , z+1) > max) max = GLO_(x  , y  , z+1);
-                glo_enqueue(x, y, z, 0, max ? max - 1 : 0);
-
-                out:
+                SET_T_(x, y, z, OPEN);
+                dirty_block(x, y, z);
+                light_broken_block(x, y, z, broken);
+                mark_unsaved(x, z);
                 p->cooldown = 5;
         }
 
         if (real && p->building && !p->cooldown && place_x >= 0) {
                 if (!collide(p->pos, (struct box){ place_x * BS, place_y * BS, place_z * BS, BS, BS, BS }))
                 {
-                        T_(place_x, place_y, place_z) = HARD;
-
-                        if (ABOVE_GROUND(place_x, place_y, place_z))
-                                GNDH_(place_x, place_z) = place_y;
-
-                        int y = place_y;
-                        remove_glolight(place_x, y, place_z);
-                        do {
-                                remove_sunlight(place_x, y, place_z);
-                                y++;
-                        } while (y < TILESH-1 && !IS_OPAQUE(place_x, y, place_z));
+                        SET_T_(place_x, place_y, place_z, HARD);
+                        dirty_block(place_x, place_y, place_z);
+                        light_placed_block(place_x, place_y, place_z);
+                        mark_unsaved(place_x, place_z);
                 }
                 p->cooldown = 10;
         }
 
         if (real && p->lighting && !p->cooldown && place_x >= 0) {
-                T_(place_x, place_y, place_z) = LITE;
-                glo_enqueue(place_x, place_y, place_z, 0, 15);
+                SET_T_(place_x, place_y, place_z, LITE);
+                dirty_block(place_x, place_y, place_z);
+                glo_enqueue(place_x, place_y, place_z, 15);
+                mark_unsaved(place_x, place_z);
                 p->cooldown = 10;
         }
 
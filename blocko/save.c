@@ -0,0 +1,314 @@
+#include "blocko.h"
+
+// worlds are saved a region of SAVE_REGION x SAVE_REGION chunks to a file, under
+// save_dir/<world seed>/r.<x>.<z>: the magic and version, then a table of where each
+// chunk is in the file and how long, then the chunks. A chunk is its tiles, then its
+// lightmap bytes, a column at a time, then its gndheights, all run length coded,
+// see rle_encode(). A chunk is written over where it was if it still fits, else
+// into the first gap between the others that does, else on the end, see
+// find_room(). Files are never compacted, so space a chunk left behind is only
+// had back when another fits it, and a file only shrinks if deleted -- keeping
+// saves to a seek and a write or two, at the price of some slack in the files
+
+// runs of the same byte as a varint count, 7 bits a byte low first, then the byte
+// out needs room for 2 * len, returns the length coded
+size_t rle_encode(unsigned char *in, size_t len, unsigned char *out)
+{
+        unsigned char *o = out;
+
+        for (size_t i = 0; i < len; )
+        {
+                size_t run = 1;
+                while (i + run < len && in[i + run] == in[i])
+                        run++;
+
+                for (size_t n = run; ; n >>= 7)
+                {
+                        *o++ = (n & 127) | (n > 127 ? 128 : 0);
+                        if (n <= 127) break;
+                }
+                *o++ = in[i];
+                i += run;
+        }
+
+        return o - out;
+}
+
+// returns false unless it decodes to exactly out_len bytes
+int rle_decode(unsigned char *in, size_t len, unsigned char *out, size_t out_len)
+{
+        unsigned char *end = in + len;
+        size_t done = 0;
+
+        while (in < end)
+        {
+                size_t run = 0;
+                for (int shift = 0; ; shift += 7)
+                {
+                        if (in == end || shift > 28) return false;
+                        run |= (size_t)(*in & 127) << shift;
+                        if (!(*in++ & 128)) break;
+                }
+
+                if (in == end || run > out_len - done) return false;
+                memset(out + done, *in++, run);
+                done += run;
+        }
+
+        return done == out_len;
+}
+
+void put_u32(unsigned char *p, unsigned v)
+{
+        for (int i = 0; i < 4; i++)
+                p[i] = v >> (i * 8);
+}
+
+unsigned get_u32(unsigned char *p)
+{
+        return p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24;
+}
+
+// the chunk's region file, making the directories for it if make_dirs
+void region_path(char *path, size_t len, int chunk_x, int chunk_z, int make_dirs)
+{
+        if (make_dirs)
+        {
+                snprintf(path, len, "%s/%u", save_dir, world_seed);
+                MKDIR(save_dir);
+                MKDIR(path);
+        }
+
+        snprintf(path, len, "%s/%u/r.%d.%d", save_dir, world_seed,
+                        chunk_x / SAVE_REGION, chunk_z / SAVE_REGION);
+}
+
+// the chunk's tiles, light and gndheight, as saved before coding
+void gather_chunk(int chunk_x, int chunk_z, unsigned char *raw)
+{
+        unsigned char *tiles = raw;
+        unsigned char *light = raw + CHUNK_TILES;
+        unsigned char *gndh = raw + 2 * CHUNK_TILES;
+
+        for (int x = chunk_x * CHUNKW; x < (chunk_x + 1) * CHUNKW; x++)
+        for (int z = chunk_z * CHUNKD; z < (chunk_z + 1) * CHUNKD; z++)
+        {
+                for (int y = 0; y < TILESH; y++)
+                {
+                        *tiles++ = TT_(x, y, z);
+                        *light++ = TLIGHT_(x, y, z);
+                }
+                *gndh++ = TGNDH_(x, z);
+        }
+}
+
+// and back into the world
+void scatter_chunk(int chunk_x, int chunk_z, unsigned char *raw)
+{
+        unsigned char *tiles = raw;
+        unsigned char *light = raw + CHUNK_TILES;
+        unsigned char *gndh = raw + 2 * CHUNK_TILES;
+
+        for (int x = chunk_x * CHUNKW; x < (chunk_x + 1) * CHUNKW; x++)
+        for (int z = chunk_z * CHUNKD; z < (chunk_z + 1) * CHUNKD; z++)
+        {
+                for (int y = 0; y < TILESH; y++)
+                {
+                        SET_TT_(x, y, z, *tiles++);
+                        TLIGHT_(x, y, z) = *light++;
+                }
+                TGNDH_(x, z) = *gndh++;
+                column_already_generated[x][z] = true; // so gen_chunk() leaves it be next door
+        }
+}
+
+struct extent { long offset, len; };
+
+int extent_cmp(const void *a, const void *b)
+{
+        long d = ((struct extent *)a)->offset - ((struct extent *)b)->offset;
+        return (d > 0) - (d < 0);
+}
+
+// where in a region file with the chunk table head to put len bytes of chunk i: the
+// first gap between the other chunks it fits in, or after the last of them
+long find_room(unsigned char *head, int i, size_t len)
+{
+        struct extent extents[SAVE_REGION * SAVE_REGION];
+        int n = 0;
+
+        for (int j = 0; j < SAVE_REGION * SAVE_REGION; j++)
+                if (j != i && get_u32(head + 8 + j * 8))
+                        extents[n++] = (struct extent){ get_u32(head + 8 + j * 8), get_u32(head + 12 + j * 8) };
+        qsort(extents, n, sizeof *extents, extent_cmp);
+
+        long at = REGION_HEAD;
+        for (int j = 0; j < n; j++)
+        {
+                if (extents[j].offset - at >= (long)len)
+                        break;
+                at = MAX(at, extents[j].offset + extents[j].len);
+        }
+
+        return at;
+}
+
+// code a gathered chunk and write it to its region file, returns false if it couldn't
+int save_chunk(int chunk_x, int chunk_z, unsigned char *raw)
+{
+        char path[300];
+        unsigned char head[REGION_HEAD] = "BLKR";
+        int i = chunk_z % SAVE_REGION * SAVE_REGION + chunk_x % SAVE_REGION;
+        int ok = false;
+
+        unsigned char *coded = malloc(2 * CHUNK_BYTES);
+        if (!coded)
+                return false;
+        size_t len = rle_encode(raw, CHUNK_BYTES, coded);
+
+        region_path(path, sizeof path, chunk_x, chunk_z, true);
+
+        SDL_LockMutex(region_lock);
+        FILE *f = fopen(path, "r+b");
+        if (f)
+        {
+                if (fread(head, REGION_HEAD, 1, f) != 1 || memcmp(head, "BLKR", 4) ||
+                                get_u32(head + 4) != REGION_VERSION)
+                        goto done; // not one of ours, leave it be
+        }
+        else
+        {
+                put_u32(head + 4, REGION_VERSION);
+                if (!(f = fopen(path, "w+b")) || fwrite(head, REGION_HEAD, 1, f) != 1)
+                        goto done;
+        }
+
+        unsigned char *entry = head + 8 + i * 8;
+        long offset = get_u32(entry);
+        if (!offset || len > get_u32(entry + 4))
+                offset = find_room(head, i, len);
+
+        put_u32(entry, offset);
+        put_u32(entry + 4, len);
+        ok = !fseek(f, offset, SEEK_SET) && fwrite(coded, len, 1, f) == 1 &&
+             !fseek(f, 8 + i * 8, SEEK_SET) && fwrite(entry, 8, 1, f) == 1;
+done:
+        if (f) fclose(f);
+        SDL_UnlockMutex(region_lock);
+        free(coded);
+        return ok;
+}
+
+// from a chunk builder, load a chunk it claimed from its region file instead of
+// generating it, returns false if it hasn't been saved
+int load_chunk(int chunk_x, int chunk_z)
+{
+        char path[300];
+        unsigned char head[REGION_HEAD];
+        unsigned char *raw = NULL;
+        int i = chunk_z % SAVE_REGION * SAVE_REGION + chunk_x % SAVE_REGION;
+        int ok = false;
+        long offset;
+        size_t len = 0;
+
+        region_path(path, sizeof path, chunk_x, chunk_z, false);
+
+        SDL_LockMutex(region_lock);
+        FILE *f = fopen(path, "rb");
+        if (!f || fread(head, REGION_HEAD, 1, f) != 1 || memcmp(head, "BLKR", 4) ||
+                        get_u32(head + 4) != REGION_VERSION)
+                goto done;
+
+        offset = get_u32(head + 8 + i * 8);
+        len = get_u32(head + 12 + i * 8);
+        if (!offset || len > 2 * CHUNK_BYTES || !(raw = malloc(CHUNK_BYTES + len)))
+                goto done;
+
+        unsigned char *coded = raw + CHUNK_BYTES;
+        ok = !fseek(f, offset, SEEK_SET) && fread(coded, len, 1, f) == 1;
+done:
+        if (f) fclose(f);
+        SDL_UnlockMutex(region_lock);
+
+        ok = ok && rle_decode(raw + CHUNK_BYTES, len, raw, CHUNK_BYTES);
+        if (ok)
+                scatter_chunk(chunk_x, chunk_z, raw);
+
+        free(raw);
+        return ok;
+}
+
+// after an edit at x, z, so its chunk gets saved; the light it changes marks the
+// chunks that spreads into, see set_sunlight()
+void mark_unsaved(int x, int z)
+{
+        if (x >= 0 && x < TILESW && z >= 0 && z < TILESD)
+                chunk_unsaved[B2C(z)][B2C(x)] = true;
+}
+
+// from the main thread once a frame: save up to max_chunks chunks changed since they
+// were last saved, leaving any with light still to spread, so they aren't saved
+// again each time it moves on, or that a chunk builder could be writing. Returns
+// how many were saved
+int save_chunks(int max_chunks)
+{
+        static unsigned char raw[CHUNK_BYTES];
+        static int next_chunk; // round robin, so no chunk waits forever
+        int first = next_chunk;
+        int saved = 0;
+
+        for (int i = 0; i < VAOS && saved < max_chunks; i++)
+        {
+                int c = (first + i) % VAOS;
+                int x = c % VAOW;
+                int z = c / VAOW;
+                if (!chunk_unsaved[z][x] || light_pending[z][x] || seeds_pending[z][x])
+                        continue;
+
+                // chunk builders write one chunk out into their neighbors, and none
+                // start while this is held
+                SDL_LockMutex(chunk_queue_lock);
+                int busy = !TAGEN_(x, z);
+                for (int dx = -1; dx <= 1; dx++) for (int dz = -1; dz <= 1; dz++)
+                        busy |= TBUSY_(x + dx, z + dz);
+                if (!busy)
+                {
+                        chunk_unsaved[z][x] = false;
+                        gather_chunk(x, z, raw);
+                }
+                SDL_UnlockMutex(chunk_queue_lock);
+
+                if (busy)
+                        continue;
+
+                if (!save_chunk(x, z, raw))
+                        save_failures++;
+                saved++;
+                next_chunk = (c + 1) % VAOS;
+        }
+
+        return saved;
+}
+
+// before quitting: stop the chunk builders, wait for the chunks they're on, finish
+// spreading light and save everything not yet saved
+void save_all_chunks()
+{
+        stop_chunk_builders = true;
+        wake_chunk_builders();
+
+        for (;;)
+        {
+                SDL_LockMutex(chunk_queue_lock);
+                int in_progress = nr_chunks_in_progress;
+                SDL_UnlockMutex(chunk_queue_lock);
+                if (!in_progress)
+                        break;
+                SDL_Delay(1);
+        }
+
+        while (step_light(1000000, 0, 0))
+                ;
+
+        save_chunks(VAOS);
+}
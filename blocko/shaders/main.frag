@@ -13,13 +13,20 @@ flat in vec3 normal;
 
 uniform sampler2DArray tarray;
 uniform sampler2DShadow shadow_map;
-uniform vec3 day_color;
-uniform vec3 glo_color;
-uniform vec3 fog_color;
-uniform vec3 light_pos;
-uniform vec3 view_pos;
-uniform float sharpness;
-uniform bool shadow_mapping;
+layout (std140) uniform frame { // see struct frame_uniforms in blocko.h
+    mat4 pv;
+    mat4 shadow_pv;
+    mat4 shadow_space;
+    vec4 light_pos;
+    vec4 view_pos;
+    vec4 day_color;
+    vec4 glo_color;
+    vec4 fog_color;
+    float BS;
+    float sharpness;
+    int shadow_mapping;
+    int water_frame;
+};
 
 void main(void)
 {
@@ -27,27 +34,27 @@ void main(void)
     float il = illum + 0.1 * smoothstep(1000, 0, eyedist);
 
     vec3 sky;
-    if (shadow_mapping)
+    if (shadow_mapping != 0)
     {
-        vec3 light_dir = normalize(light_pos - world_pos.xyz);
+        vec3 light_dir = normalize(light_pos.xyz - world_pos.xyz);
         float diff = max(dot(light_dir, normal), 0.0);
-        vec3 view_dir = normalize(view_pos - world_pos.xyz);
+        vec3 view_dir = normalize(view_pos.xyz - world_pos.xyz);
         vec3 halfway_dir = normalize(light_dir + view_dir);
         float spec = pow(max(dot(normal, halfway_dir), 0), 16);
         float unshadow = textureProj(shadow_map, vec4(shadow_pos.xyz, 1));
         float s0 = 0.6 + 0.4 * sharpness;
         float s1 = 0.3 + 0.7 * (1-sharpness);
-        sky = vec3(s1 * il + s0 * unshadow * (diff + spec)) * day_color;
+        sky = vec3(s1 * il + s0 * unshadow * (diff + spec)) * day_color.rgb;
     }
     else
     {
-        sky = vec3(il) * day_color;
+        sky = vec3(il) * day_color.rgb;
     }
 
-    vec3 glo = vec3(glow * glo_color);
+    vec3 glo = vec3(glow * glo_color.rgb);
     vec3 unsky = vec3(1 - sky.r, 1 - sky.g, 1 - sky.b);
     vec4 combined = vec4(sky + glo * unsky, alpha);
     vec4 c = texture(tarray, vec3(uv, tex)) * combined;
     if (c.a < 0.01) discard;
-    color = mix(c, vec4(fog_color, 1), fog);
+    color = mix(c, vec4(fog_color.rgb, 1), fog);
 }
@@ -1,31 +1,47 @@
 #version 330 core
-layout (location = 0) in float tex_in;
-layout (location = 1) in float orient_in;
-layout (location = 2) in vec3 pos_in;
-layout (location = 3) in vec4 illum_in;
-layout (location = 4) in vec4 glow_in;
-layout (location = 5) in float alpha_in;
+// see struct vbufv in blocko.h
+layout (location = 0) in uint pos_in;
+layout (location = 1) in uint info_in;
+layout (location = 2) in uvec4 illum_in;
+layout (location = 3) in uvec4 glow_in;
+layout (location = 4) in vec2 chunk_in; // chunk origin in blocks, one per draw
 
 out float tex_vs;
 out float orient_vs;
+out vec2 size_vs;
 out vec4 illum_vs;
 out vec4 glow_vs;
 out float alpha_vs;
 out vec4 world_pos_vs;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
-uniform float BS;
+layout (std140) uniform frame { // see struct frame_uniforms in blocko.h
+    mat4 pv;
+    mat4 shadow_pv;
+    mat4 shadow_space;
+    vec4 light_pos;
+    vec4 view_pos;
+    vec4 day_color;
+    vec4 glo_color;
+    vec4 fog_color;
+    float BS;
+    float sharpness;
+    int shadow_mapping;
+    int water_frame;
+};
 
 void main(void)
 {
-    vec3 pos = BS * pos_in;
-    gl_Position = proj * view * model * vec4(pos, 1);
-    world_pos_vs = model * vec4(pos, 1);
-    tex_vs = tex_in;
-    orient_vs = orient_in;
-    illum_vs = illum_in;
-    glow_vs = glow_in;
-    alpha_vs = alpha_in;
+    vec3 pos = BS * (vec3(pos_in & 511u, pos_in >> 18 & 4095u, pos_in >> 9 & 511u) / 16.0 - 1.0
+                     + vec3(chunk_in.x, 0, chunk_in.y));
+    gl_Position = pv * vec4(pos, 1);
+    world_pos_vs = vec4(pos, 1);
+    uint tex = info_in & 255u;
+    if (tex >= 7u && tex <= 10u) // water, animated
+        tex = 7u + (tex - 7u + uint(water_frame)) % 4u;
+    tex_vs = float(tex);
+    orient_vs = float(info_in >> 8 & 7u);
+    size_vs = vec2((info_in >> 11 & 15u) + 1u, (info_in >> 15 & 255u) + 1u);
+    illum_vs = vec4(illum_in) / 125.0;
+    glow_vs = vec4(glow_in) / 125.0;
+    alpha_vs = float(info_in >> 23 & 255u) / 255.0;
 }
@@ -5,6 +5,8 @@ float hmap2[TILESW][TILESD];
 
 int tscootx, tscootz, tchunk_scootx, tchunk_scootz;
 
+struct cave_region cave_regions[TILESW / REGW][TILESD / REGD];
+
 void gen_hmap(int x0, int x2, int z0, int z2)
 {
         unsigned seed = SEED4(x0, x2, z0, z2);
@@ -118,8 +120,158 @@ void create_hmap()
         }
 
         smooth_hmap();
+        hmap_created = true;
+}
+
+// walk all the bezier curves of a region's cave system, keeping every point
+// so chunks in the region can pick out their own without walking them again
+void walk_cave_region(struct cave_region *reg, int rxlo, int rzlo)
+{
+        unsigned seed = SEED2(rxlo, rzlo);
+        // find region center
+        int rxcenter = rxlo + REGW/2;
+        int rzcenter = rzlo + REGD/2;
+        struct point PC = (struct point){rxcenter, TILESH - RANDI(1, 25), rzcenter};
+        struct point P0;
+        struct point P1;
+        struct point P2;
+        struct point P3 = PC;
+        int nr_caves = RANDI(0, MAX_CAVE_CURVES);
+
+        // cave system stretchiness
+        int sx = RANDI(10, 60);
+        int sy = RANDI(10, 60);
+        int sz = RANDI(10, 60);
+
+        int cap = 0;
+        reg->nr_curves = nr_caves;
+        reg->len = 0;
+
+        for (int i = 0; i < nr_caves; i++)
+        {
+                struct cave_curve *c = reg->curves + i;
+                *c = (struct cave_curve){ TILESW, -1, TILESD, -1, reg->len, 0 };
+
+                // random walk from center of region, or end of last curve
+                P0 = RANDP(33) ? PC : P3;
+                P1 = (struct point){P0.x + RANDI(-sx, sx), P0.y + RANDI(-sy, sy), P0.z + RANDI(-sz, sz)};
+                P2 = (struct point){P1.x + RANDI(-sx, sx), P1.y + RANDI(-sy, sy), P1.z + RANDI(-sz, sz)};
+                P3 = (struct point){P2.x + RANDI(-sx, sx), P2.y + RANDI(-sy, sy), P2.z + RANDI(-sz, sz)};
+
+                float root_radius = 0.f, delta = 0.f;
+
+                for (float t = 0.f; t <= 1.f; t += 0.001f)
+                {
+                        if (root_radius == 0.f || RANDP(0.002f))
+                        {
+                                root_radius = RAND01;
+                                delta = RANDF(-0.001f, 0.001f);
+                        }
+
+                        root_radius += delta;
+                        float radius_sq = root_radius * root_radius * root_radius * root_radius * 50.f;
+                        CLAMP(radius_sq, 1.f, 50.f);
+
+                        float s = 1.f - t;
+                        int x = (int)(s*s*s*P0.x + 3.f*t*s*s*P1.x + 3.f*t*t*s*P2.x + t*t*t*P3.x);
+                        int y = (int)(s*s*s*P0.y + 3.f*t*s*s*P1.y + 3.f*t*t*s*P2.y + t*t*t*P3.y);
+                        int z = (int)(s*s*s*P0.z + 3.f*t*s*s*P1.z + 3.f*t*t*s*P2.z + t*t*t*P3.z);
+
+                        if (reg->len >= cap)
+                        {
+                                cap = cap ? cap * 2 : 16384;
+                                reg->points = realloc(reg->points, cap * sizeof *reg->points);
+                                if (!reg->points) exit(fprintf(stderr, "Out of memory for caves\n"));
+                        }
+
+                        reg->points[reg->len++] = QCAVE(x, y, z, radius_sq);
+                        c->len++;
+                        if (x < c->xlo) c->xlo = x;
+                        if (x > c->xhi) c->xhi = x;
+                        if (z < c->zlo) c->zlo = z;
+                        if (z > c->zhi) c->zhi = z;
+                }
+        }
+
+        reg->ready = true;
 }
 
+// find the cave system for a region, walking it the first time it's needed
+struct cave_region *get_cave_region(int rxlo, int rzlo)
+{
+        struct cave_region *reg = &cave_regions[rxlo / REGW][rzlo / REGD];
+
+        #pragma omp critical (cave_region)
+        if (!reg->ready)
+                walk_cave_region(reg, rxlo, rzlo);
+
+        return reg;
+}
+
+// large-scale octaves hardly change from one voxel to the next, so those in
+// lattice_octaves are only sampled every LATTICE tiles and interpolated between
+#define LATW (CHUNKW / LATTICE + 3)  // lattice nodes across a chunk plus its overdrawn edges
+#define LATD (CHUNKD / LATTICE + 3)  // ^
+#define LATH (TILESH / LATTICE + 1)  // ^
+
+struct lattice {
+        int mask;
+        int x0, z0; // position of node [0][0] in lattice units
+        float p300[LATW][LATD][LATH];
+        float p90[LATW][LATD][LATH];
+        float p91[LATW][LATD][LATH];
+};
+
+void fill_lattice(struct lattice *lat, int xlo, int xhi, int zlo, int zhi)
+{
+        lat->mask = lattice_octaves;
+        lat->x0 = xlo / LATTICE;
+        lat->z0 = zlo / LATTICE;
+        int w = (xhi - 1) / LATTICE + 2 - lat->x0;
+        int d = (zhi - 1) / LATTICE + 2 - lat->z0;
+
+        if (w > LATW || d > LATD)
+                lat->mask = 0; // bigger than a chunk, just sample every voxel
+
+        if (!lat->mask)
+                return;
+
+        int n;
+        #pragma omp parallel for
+        for (n = 0; n < w * d; n++) for (int j = 0; j < LATH; j++)
+        {
+                int i = n / d;
+                int k = n % d;
+                int x = (lat->x0 + i) * LATTICE;
+                int y = j * LATTICE;
+                int z = (lat->z0 + k) * LATTICE;
+
+                if (lat->mask & LAT_P300) lat->p300[i][k][j] = noise(x, y, z, 300);
+                if (lat->mask & LAT_P90)  lat->p90[i][k][j]  = noise(x, y, z, 90);
+                if (lat->mask & LAT_P91)  lat->p91[i][k][j]  = noise(x+1000, y+1000, z+1000, 91);
+        }
+}
+
+// interpolate one octave of the lattice at column x, z, leaving one value per node in y
+void lattice_column(float *col, float grid[LATW][LATD][LATH], struct lattice *lat, int x, int z)
+{
+        int i = x / LATTICE - lat->x0;
+        int k = z / LATTICE - lat->z0;
+        float fx = (x % LATTICE) * (1.f / LATTICE);
+        float fz = (z % LATTICE) * (1.f / LATTICE);
+
+        for (int j = 0; j < LATH; j++)
+        {
+                float a = grid[i][k  ][j] + (grid[i+1][k  ][j] - grid[i][k  ][j]) * fx;
+                float b = grid[i][k+1][j] + (grid[i+1][k+1][j] - grid[i][k+1][j]) * fx;
+                col[j] = a + (b - a) * fz;
+        }
+}
+
+// then interpolate in y
+#define LATTICE_Y(col, y) ((col)[(y) / LATTICE] + \
+                ((col)[(y) / LATTICE + 1] - (col)[(y) / LATTICE]) * ((y) % LATTICE) * (1.f / LATTICE))
+
 void gen_chunk(int xlo, int xhi, int zlo, int zhi)
 {
         CLAMP(xlo, 0, TILESW-1);
@@ -127,9 +279,11 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
         CLAMP(zlo, 0, TILESD-1);
         CLAMP(zhi, 0, TILESD-1);
 
-        static char column_already_generated[TILESW][TILESD];
-
         int x;
+        unsigned long long stage_then = SDL_GetPerformanceCounter();
+
+        struct lattice lat;
+        fill_lattice(&lat, xlo, xhi, zlo, zhi);
 
         #pragma omp parallel for
         for (x = xlo; x < xhi; x++) for (int z = zlo; z < zhi; z++)
@@ -149,6 +303,11 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                 float p15 = noise(z, 0, -x, 15);
                 //float p5 = noise(-x, 0, z, 5);
 
+                float col300[LATH], col90[LATH], col91[LATH];
+                if (lat.mask & LAT_P300) lattice_column(col300, lat.p300, &lat, x, z);
+                if (lat.mask & LAT_P90)  lattice_column(col90,  lat.p90,  &lat, x, z);
+                if (lat.mask & LAT_P91)  lattice_column(col91,  lat.p91,  &lat, x, z);
+
                 if (p200 > 0.2f)
                 {
                         float flatten = (p200 - 0.2f) * 80;
@@ -165,14 +324,14 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
 
                 for (int y = 0; y < TILESH; y++)
                 {
-                        if (y == TILESH - 1) { TT_(x, y, z) = HARD; continue; }
+                        if (y == TILESH - 1) { SET_TT_(x, y, z, HARD); continue; }
 
-                        float p300 = noise(x, y, z, 300);
+                        float p300 = lat.mask & LAT_P300 ? LATTICE_Y(col300, y) : noise(x, y, z, 300);
                         float p32 = noise(x, y*mode, z, 16 + 16 * (1.1 + p300));
                         float plat = p32 > 0.3 ? (10 - 30 * (p32 * p32 * p32 - 0.3)) : 0;
 
-                        float p90 = noise(x, y, z, 90);
-                        float p91 = noise(x+1000, y+1000, z+1000, 91);
+                        float p90 = lat.mask & LAT_P90 ? LATTICE_Y(col90, y) : noise(x, y, z, 90);
+                        float p91 = lat.mask & LAT_P91 ? LATTICE_Y(col91, y) : noise(x+1000, y+1000, z+1000, 91);
                         float p42 = noise(x, y*(p300 + 1), z, 42);
                         float p9  = noise(x, y*0.05, z, 9);
                         float p2  = noise(-z, y, x, 2);
@@ -193,7 +352,7 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                                 if (!slicey_bit || RANDP(5))
                                 {
                                         int type = (y > 100 && hmap2[x][z] > 99) ? WATR : OPEN; //only allow water below low heightmap
-                                        TT_(x, y, z) = type;
+                                        SET_TT_(x, y, z, type);
                                         solid_depth = 0;
                                         slicey_bit = false;
                                         goto out;
@@ -213,92 +372,70 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                         int ore  =  p2 > 0.4f ? ORE : OREH;
                         int ston = p42 > 0.4f && p9 < -0.3f ? ore : STON;
 
-                        if      (slicey_bit)          TT_(x, y, z) = p9 > 0.4f ? HARD : SAND;
-                        else if (solid_depth > 14 + 5 * p9) TT_(x, y, z) = GRAN;
-                        else if (y < slv - 5 * p16)   TT_(x, y, z) = ston;
-                        else if (y < dlv - 5 * p16)   TT_(x, y, z) = p80 > (-solid_depth * 0.1f) ? DIRT : OPEN; // erosion
-                        else if (y < 100 - 5 * p16)   TT_(x, y, z) = solid_depth == 1 ? GRAS : DIRT;
-                        else if (y < 120          )   TT_(x, y, z) = solid_depth < 4 + 5 * p9 ? SAND : ston;
-                        else                          TT_(x, y, z) = HARD;
+                        if      (slicey_bit)          SET_TT_(x, y, z, p9 > 0.4f ? HARD : SAND);
+                        else if (solid_depth > 14 + 5 * p9) SET_TT_(x, y, z, GRAN);
+                        else if (y < slv - 5 * p16)   SET_TT_(x, y, z, ston);
+                        else if (y < dlv - 5 * p16)   SET_TT_(x, y, z, p80 > (-solid_depth * 0.1f) ? DIRT : OPEN); // erosion
+                        else if (y < 100 - 5 * p16)   SET_TT_(x, y, z, solid_depth == 1 ? GRAS : DIRT);
+                        else if (y < 120          )   SET_TT_(x, y, z, solid_depth < 4 + 5 * p9 ? SAND : ston);
+                        else                          SET_TT_(x, y, z, HARD);
 
                         out: ;
                 }
         }
 
+        STAGE(column_noise, stage_then);
+
         // find nearby bezier curvy caves
-        #define REGW (CHUNKW*16)
-        #define REGD (CHUNKD*16)
         // find region          ,-- have to add 1 bc we're overdrawing chunks
         // lower bound         /
         int rxlo = (int)((xlo+1) / REGW) * REGW;
         int rzlo = (int)((zlo+1) / REGD) * REGD;
-        unsigned seed = SEED2(rxlo, rzlo);
-        // find region center
-        int rxcenter = rxlo + REGW/2;
-        int rzcenter = rzlo + REGD/2;
-        struct point PC = (struct point){rxcenter, TILESH - RANDI(1, 25), rzcenter};
-        struct point P0;
-        struct point P1;
-        struct point P2;
-        struct point P3 = PC;
-        int nr_caves = RANDI(0, 100);
-
-        // cave system stretchiness
-        int sx = RANDI(10, 60);
-        int sy = RANDI(10, 60);
-        int sz = RANDI(10, 60);
+        struct cave_region *reg = get_cave_region(rxlo, rzlo);
 
-        #define MAX_CAVE_POINTS 10000
-        #define QCAVE(x,y,z,radius_sq) ((struct qcave){x, y, z, radius_sq})
         struct qcave cave_points[MAX_CAVE_POINTS];
         int cave_p_len = 0;
 
-        for (int i = 0; i < nr_caves; i++)
+        for (int i = 0; i < reg->nr_curves && cave_p_len < MAX_CAVE_POINTS; i++)
         {
-                // random walk from center of region, or end of last curve
-                P0 = RANDP(33) ? PC : P3;
-                P1 = (struct point){P0.x + RANDI(-sx, sx), P0.y + RANDI(-sy, sy), P0.z + RANDI(-sz, sz)};
-                P2 = (struct point){P1.x + RANDI(-sx, sx), P1.y + RANDI(-sy, sy), P1.z + RANDI(-sz, sz)};
-                P3 = (struct point){P2.x + RANDI(-sx, sx), P2.y + RANDI(-sy, sy), P2.z + RANDI(-sz, sz)};
+                struct cave_curve *c = reg->curves + i;
 
-                float root_radius = 0.f, delta = 0.f;
+                if (c->xhi < xlo || c->xlo > xhi || c->zhi < zlo || c->zlo > zhi)
+                        continue; // curve doesn't touch this chunk
 
-                for (float t = 0.f; t <= 1.f; t += 0.001f)
+                for (int j = c->start; j < c->start + c->len && cave_p_len < MAX_CAVE_POINTS; j++)
                 {
-                        if (cave_p_len >= MAX_CAVE_POINTS) break;
+                        struct qcave p = reg->points[j];
+                        if (p.x >= xlo && p.x <= xhi && p.y >= 0 && p.y <= TILESD - 1 && p.z >= zlo && p.z <= zhi)
+                                cave_points[cave_p_len++] = p;
+                }
+        }
 
-                        if (root_radius == 0.f || RANDP(0.002f))
-                        {
-                                root_radius = RAND01;
-                                delta = RANDF(-0.001f, 0.001f);
-                        }
+        STAGE(cave_collect, stage_then);
 
-                        root_radius += delta;
-                        float radius_sq = root_radius * root_radius * root_radius * root_radius * 50.f;
-                        CLAMP(radius_sq, 1.f, 50.f);
+        // carve caves by stamping each cave point's sphere into the chunk
+        for (int i = 0; i < cave_p_len; i++)
+        {
+                struct qcave *c = cave_points + i;
 
-                        float s = 1.f - t;
-                        int x = (int)(s*s*s*P0.x + 3.f*t*s*s*P1.x + 3.f*t*t*s*P2.x + t*t*t*P3.x);
-                        int y = (int)(s*s*s*P0.y + 3.f*t*s*s*P1.y + 3.f*t*t*s*P2.y + t*t*t*P3.y);
-                        int z = (int)(s*s*s*P0.z + 3.f*t*s*s*P1.z + 3.f*t*t*s*P2.z + t*t*t*P3.z);
-                        // TODO: don't store duplicate cave points?
-                        if (x >= xlo && x <= xhi && y >= 0 && y <= TILESD - 1 && z >= zlo && z <= zhi)
-                                cave_points[cave_p_len++] = QCAVE(x, y, z, radius_sq);
-                }
+                // neighboring points on a curve often land on the same block
+                if (i && c->x == c[-1].x && c->y == c[-1].y && c->z == c[-1].z &&
+                                c->radius_sq <= c[-1].radius_sq)
+                        continue;
+
+                int r = 0;
+                while ((r + 1) * (r + 1) <= c->radius_sq) r++;
+
+                int cxlo = MAX(c->x - r, xlo), cxhi = MIN(c->x + r, xhi - 1);
+                int cylo = MAX(c->y - r, 0),   cyhi = MIN(c->y + r, TILESH - 3);
+                int czlo = MAX(c->z - r, zlo), czhi = MIN(c->z + r, zhi - 1);
+
+                for (int x = cxlo; x <= cxhi; x++) for (int z = czlo; z <= czhi; z++) for (int y = cylo; y <= cyhi; y++)
+                        if (DIST_SQ(c->x - x, c->y - y, c->z - z) <= c->radius_sq)
+                                SET_TT_(x, y, z, OPEN);
         }
 
-        // carve caves
-        #pragma omp parallel for
-        for (x = xlo; x < xhi; x++) for (int z = zlo; z < zhi; z++) for (int y = 0; y < TILESH-2; y++)
-                for (int i = 0; i < cave_p_len; i++)
-                {
-                        int dist_sq = DIST_SQ(cave_points[i].x - x, cave_points[i].y - y, cave_points[i].z - z);
-                        if (dist_sq <= cave_points[i].radius_sq)
-                        {
-                                TT_(x, y, z) = OPEN;
-                                break;
-                        }
-                }
+        STAGE(cave_carve, stage_then);
 
         // correcting pass over middle, contain floating water
         #pragma omp parallel for
@@ -311,13 +448,15 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                             TT_(x-1, y  , z  ) == OPEN ||
                             TT_(x+1, y  , z  ) == OPEN ||
                             TT_(x  , y+1, z  ) == OPEN)
-                                TT_(x, y, z) = WOOD;
+                                SET_TT_(x, y, z, WOOD);
                 }
         }
 
+        STAGE(water_fixup, stage_then);
+
         // trees?
         float p191 = noise(zlo, 0, xlo, 191);
-        seed = SEED2(xlo, zlo);
+        unsigned seed = SEED2(xlo, zlo);
         if (p191 > 0.2f) while (RANDP(95))
         {
                 char leaves = RANDBOOL ? RLEF : YLEF;
@@ -334,7 +473,7 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
 
                         int yy = y;
                         for (; yy >= y - RANDI(3, 8); yy--)
-                                TT_(x, yy, z) = WOOD;
+                                SET_TT_(x, yy, z, WOOD);
 
                         int ymax = yy + RANDI(2, 4);
 
@@ -342,13 +481,15 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                         {
                                 float dist = (i-x) * (i-x) + (j-yy) * (j-yy) + (k-z) * (k-z);
                                 if (TT_(i, j, k) == OPEN && dist < radius * radius)
-                                        TT_(i, j, k) = leaves;
+                                        SET_TT_(i, j, k, leaves);
                         }
 
                         break;
                 }
         }
 
+        STAGE(trees, stage_then);
+
         // cleanup gndheight and set initial lighting
         #pragma omp parallel for
         for (x = xlo+1; x < xhi-1; x++) for (int z = zlo+1; z < zhi-1; z++)
@@ -364,15 +505,12 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                                 TGNDH_(x, z) = y;
                                 above_ground = false;
                                 if (y)
-                                {
-                                        TSUN_(x, y-1, z) = 0;
-                                        sun_enqueue(x, y-1, z, 0, light_level);
-                                }
+                                        sun_seed(x, y-1, z, light_level);
                                 light_level = 0;
                         }
 
                         if (wet && TT_(x, y, z) == OPEN)
-                                TT_(x, y, z) = WATR;
+                                SET_TT_(x, y, z, WATR);
 
                         if (wet && IS_SOLID(x, y, z))
                                 wet = false;
@@ -384,11 +522,11 @@ void gen_chunk(int xlo, int xhi, int zlo, int zhi)
                                 if (light_level) light_level--;
                         }
 
-                        TSUN_(x, y, z) = light_level;
+                        SET_TSUN_(x, y, z, light_level);
                 }
         }
 
-        recalc_corner_lighting(xlo, xhi, zlo, zhi);
+        STAGE(light_init, stage_then);
 }
 
 // update terrain worker thread(s) copies of scoot vars
@@ -403,55 +541,232 @@ void terrain_apply_scoot()
         }
 }
 
-// on its own thread, loops forever building chunks when needed
-void chunk_builder()
-{ for(;;) {
-        terrain_apply_scoot();
+// chunks left to generate as a binary min-heap, nearest to the player first,
+// holding {chunk x, distance sq, chunk z} like draw_stuff()'s ring items
+struct qitem chunk_heap[VAOS];
+int chunk_heap_len;
+int heap_px = -1, heap_pz = -1;     // player chunk the heap is keyed for
+int heap_scootx, heap_scootz;       // and tchunk_scootx, z
+
+// ties go to lower x, then lower z
+int chunk_before(struct qitem a, struct qitem b)
+{
+        if (a.y != b.y) return a.y < b.y;
+        if (a.x != b.x) return a.x < b.x;
+        return a.z < b.z;
+}
+
+void chunk_heap_sift_down(int i)
+{
+        struct qitem c = chunk_heap[i];
+
+        for (;;)
+        {
+                int child = 2 * i + 1;
+                if (child >= chunk_heap_len)
+                        break;
+                if (child + 1 < chunk_heap_len && chunk_before(chunk_heap[child + 1], chunk_heap[child]))
+                        child++;
+                if (!chunk_before(chunk_heap[child], c))
+                        break;
+                chunk_heap[i] = chunk_heap[child];
+                i = child;
+        }
+
+        chunk_heap[i] = c;
+}
+
+void chunk_heap_push(struct qitem c)
+{
+        int i = chunk_heap_len++;
+
+        while (i && chunk_before(c, chunk_heap[(i - 1) / 2]))
+        {
+                chunk_heap[i] = chunk_heap[(i - 1) / 2];
+                i = (i - 1) / 2;
+        }
+
+        chunk_heap[i] = c;
+}
+
+struct qitem chunk_heap_pop()
+{
+        struct qitem top = chunk_heap[0];
+
+        chunk_heap[0] = chunk_heap[--chunk_heap_len];
+        if (chunk_heap_len)
+                chunk_heap_sift_down(0);
+
+        return top;
+}
+
+// re-key all the ungenerated chunks, when the player changes chunk or the world scoots
+void rebuild_chunk_heap(int px, int pz)
+{
+        chunk_heap_len = 0;
+
+        for (int x = 0; x < VAOW; x++) for (int z = 0; z < VAOD; z++)
+        {
+                if (TAGEN_(x, z) || TBUSY_(x, z)) continue;
+
+                int dist_sq = (x - px) * (x - px) + (z - pz) * (z - pz);
+                chunk_heap[chunk_heap_len++] = QITEM(x, dist_sq, z);
+        }
+
+        for (int i = chunk_heap_len / 2 - 1; i >= 0; i--)
+                chunk_heap_sift_down(i);
+
+        heap_px = px;
+        heap_pz = pz;
+        heap_scootx = tchunk_scootx;
+        heap_scootz = tchunk_scootz;
+}
+
+// take the nearest chunk to the player that's not generated yet, skipping any next
+// to a chunk in progress -- neighbors overdraw each other's edge columns
+// call with chunk_queue_lock held
+int claim_chunk(int *chunk_x, int *chunk_z)
+{
+        // scoot only while no one is mid-chunk, holding off new chunks until then
+        int scooting = tchunk_scootx != future_scootx || tchunk_scootz != future_scootz;
+        if (!nr_chunks_in_progress)
+                terrain_apply_scoot();
+        else if (scooting)
+                return false;
 
-        int best_x = 0, best_z = 0;
         int px = (player[0].pos.x / BS + CHUNKW2) / CHUNKW;
         int pz = (player[0].pos.z / BS + CHUNKD2) / CHUNKD;
         CLAMP(px, 0, VAOW-1);
         CLAMP(pz, 0, VAOD-1);
 
-        // find nearest ungenerated chunk
-        int best_dist = 99999999;
-        for (int x = 0; x < VAOW; x++) for (int z = 0; z < VAOD; z++)
+        if (px != heap_px || pz != heap_pz || tchunk_scootx != heap_scootx || tchunk_scootz != heap_scootz)
+                rebuild_chunk_heap(px, pz);
+
+        static struct qitem blocked[VAOS];
+        int nr_blocked = 0;
+        int found = false;
+
+        while (chunk_heap_len && !found)
         {
-                if (TAGEN_(x, z)) continue;
+                struct qitem c = chunk_heap_pop();
+                int x = c.x;
+                int z = c.z;
 
-                int dist_sq = (x - px) * (x - px) + (z - pz) * (z - pz);
-                if (dist_sq < best_dist)
+                if (TBUSY_(x-1, z-1) || TBUSY_(x, z-1) || TBUSY_(x+1, z-1) ||
+                    TBUSY_(x-1, z  ) ||                   TBUSY_(x+1, z  ) ||
+                    TBUSY_(x-1, z+1) || TBUSY_(x, z+1) || TBUSY_(x+1, z+1))
                 {
-                        best_dist = dist_sq;
-                        best_x = x;
-                        best_z = z;
+                        blocked[nr_blocked++] = c;
+                        continue;
                 }
-        }
 
-        if (best_dist == 99999999)
-        {
-                SDL_Delay(1);
-                continue;
+                TBUSY_(x, z) = true;
+                nr_chunks_in_progress++;
+                *chunk_x = x;
+                *chunk_z = z;
+                found = true;
         }
 
-        int xlo = best_x * CHUNKW;
-        int zlo = best_z * CHUNKD;
+        while (nr_blocked)
+                chunk_heap_push(blocked[--nr_blocked]);
+
+        return found;
+}
+
+void wake_chunk_builders()
+{
+        SDL_LockMutex(chunk_queue_lock);
+        SDL_CondBroadcast(chunk_queue_changed);
+        SDL_UnlockMutex(chunk_queue_lock);
+}
+
+// from the main thread, so waiting chunk builders re-sort when the player moves on
+void notice_player_chunk()
+{
+        static int last_px = -1, last_pz = -1;
+        int px = (player[0].pos.x / BS + CHUNKW2) / CHUNKW;
+        int pz = (player[0].pos.z / BS + CHUNKD2) / CHUNKD;
+
+        if (px == last_px && pz == last_pz)
+                return;
+
+        last_px = px;
+        last_pz = pz;
+        wake_chunk_builders();
+}
+
+void finish_chunk(int chunk_x, int chunk_z, int loaded)
+{
+        SDL_LockMutex(chunk_queue_lock);
+        TAGEN_(chunk_x, chunk_z) = true;
+        TBUSY_(chunk_x, chunk_z) = false;
+        nr_chunks_in_progress--;
+
+        // gen_chunk() wrote a tile into each neighbor too, so they need saving again
+        for (int x = MAX(chunk_x - 1, 0); x <= MIN(chunk_x + 1, VAOW - 1); x++)
+                for (int z = MAX(chunk_z - 1, 0); z <= MIN(chunk_z + 1, VAOD - 1); z++)
+                {
+                        for (int s = 0; s < SECTIONS; s++)
+                                TDIRTY_(x, s, z) = true;
+                        if (!loaded)
+                                chunk_unsaved[z][x] = true;
+                }
+
+        SDL_CondBroadcast(chunk_queue_changed);
+        SDL_UnlockMutex(chunk_queue_lock);
+}
+
+// generate the nearest chunk that can be, if wait then sleeping until there is one
+// returns false if no chunk was built
+int build_chunk(int wait)
+{
+        int chunk_x, chunk_z, claimed = false;
+
+        // none claimed once stopped, so save_all_chunks() can wait out the rest
+        SDL_LockMutex(chunk_queue_lock);
+        while (!stop_chunk_builders && !(claimed = claim_chunk(&chunk_x, &chunk_z)) && wait)
+                SDL_CondWait(chunk_queue_changed, chunk_queue_lock);
+        SDL_UnlockMutex(chunk_queue_lock);
+
+        if (!claimed)
+                return false;
+
+        int xlo = chunk_x * CHUNKW;
+        int zlo = chunk_z * CHUNKD;
         int xhi = xlo + CHUNKW;
         int zhi = zlo + CHUNKD;
 
+        begin_tile_reads();
         int ticks_before = SDL_GetTicks();
-        gen_chunk(xlo-1, xhi+1, zlo-1, zhi+1);
-        nr_chunks_generated++;
-        chunk_gen_ticks += SDL_GetTicks() - ticks_before;
+        int loaded = load_chunk(chunk_x, chunk_z);
+        if (!loaded)
+        {
+                // only needed once a chunk has to be generated
+                #pragma omp critical (create_hmap)
+                if (!hmap_created)
+                        create_hmap();
 
-        TAGEN_(best_x, best_z) = true;
+                gen_chunk(xlo-1, xhi+1, zlo-1, zhi+1);
+        }
 
-        #pragma omp critical
+        #pragma omp atomic
+        nr_chunks_generated++;
+        #pragma omp atomic
+        chunk_gen_ticks += SDL_GetTicks() - ticks_before;
+        if (loaded)
         {
-                just_generated[just_gen_len].x = best_x;
-                just_generated[just_gen_len].z = best_z;
-                just_gen_len++;
+                #pragma omp atomic
+                nr_chunks_loaded++;
         }
-} }
 
+        finish_chunk(chunk_x, chunk_z, loaded);
+        end_tile_reads();
+        return true;
+}
+
+// on each of the chunk_workers threads, loops building chunks as they're needed
+void chunk_builder()
+{
+        while (!stop_chunk_builders)
+                build_chunk(true);
+}
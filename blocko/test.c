@@ -24,35 +24,35 @@ void build_test_area()
                 {
                         if (on_edge)
                         {
-                                T_(x, y, z) = OPEN;
-                                SUN_(x, y, z) = 15;
+                                SET_T_(x, y, z, OPEN);
+                                SET_SUN_(x, y, z, 15);
                         }
                         else
                         {
-                                T_(x, y, z) = GRAN;
-                                SUN_(x, y, z) = 0;
+                                SET_T_(x, y, z, GRAN);
+                                SET_SUN_(x, y, z, 0);
                                 GNDH_(x, z) = y;
                         }
                 }
                 else if (y < ty + 1) // space inside
                 {
-                        T_(x, y, z) = OPEN;
-                        SUN_(x, y, z) = 0;
+                        SET_T_(x, y, z, OPEN);
+                        SET_SUN_(x, y, z, 0);
                         if (on_edge)
                         {
                                 GNDH_(x, z) = y;
-                                sun_enqueue(x, y, z, 0, 15);
+                                sun_enqueue(x, y, z, 15);
                         }
                 }
                 else // floor
                 {
-                        T_(x, y, z) = GRAN;
-                        SUN_(x, y, z) = 0;
+                        SET_T_(x, y, z, GRAN);
+                        SET_SUN_(x, y, z, 0);
                 }
 
         }
 
-        recalc_corner_lighting(tx, tx + TEST_AREA_SZ, tz, tz + TEST_AREA_SZ);
+        dirty_all_chunks(); // old test area too
 }
 
 void debrief()
@@ -66,6 +66,22 @@ void debrief()
         static char timings_buf[8000];
         char *p = buf;
 
+        // histogram of frame times over the last second, to catch spikes the fps hides
+        static float hist_ms[] = { 8, 17, 25, 33, 50, 100, INFINITY };
+        static int hist[sizeof hist_ms / sizeof *hist_ms];
+        static float worst_ms = 0;
+        static unsigned long long last_counter = 0;
+        unsigned long long counter = SDL_GetPerformanceCounter();
+        if (last_counter)
+        {
+                float ms = 1000.f * (counter - last_counter) / SDL_GetPerformanceFrequency();
+                int i = 0;
+                while (ms >= hist_ms[i]) i++;
+                hist[i]++;
+                if (ms > worst_ms) worst_ms = ms;
+        }
+        last_counter = counter;
+
         if (ticks - last_ticks >= 1000) {
                 float elapsed = ((float)ticks - last_ticks);
                 float frames = frame - last_frame;
@@ -77,34 +93,85 @@ void debrief()
                                 ((float)avail_kb / total_kb) * 100.f);
 
                 p += snprintf(p, 8000 - (p-buf),
-                                "%d omp, %0.2f chunk/s\n",
-                                omp_threads,
-                                (float)nr_chunks_generated / (chunk_gen_ticks / 1000.f));
+                                "%d chunk workers, %0.2f chunk/s, %d loaded\n",
+                                chunk_workers,
+                                (float)nr_chunks_generated * chunk_workers / (chunk_gen_ticks / 1000.f),
+                                nr_chunks_loaded);
+
+                p += snprintf(p, 8000 - (p-buf),
+                                "%d mesh workers, %.1f meshes/s\n",
+                                mesh_workers,
+                                1000.f * meshes_uploaded / elapsed);
+
+                p += snprintf(p, 8000 - (p-buf),
+                                "%.1fk uploaded/frame, most %.1fk, %s\n",
+                                frames ? bytes_uploaded / frames / 1000.f : 0.f,
+                                most_bytes_uploaded / 1000.f,
+                                use_buffer_storage ? "mapped ring" : "glBufferSubData");
 
                 p += snprintf(p, 8000 - (p-buf),
                                 "%.3fm poly/s, %.3f shadow poly/s\n",
                                 1000.f * (float)polys / elapsed / 1000000.f,
                                 1000.f * (float)shadow_polys / elapsed / 1000000.f);
 
+                p += snprintf(p, 8000 - (p-buf),
+                                "%d sections drawn, %d out of view, %d occluded, %d not casting shadows\n",
+                                sections_drawn, sections_out_of_view, sections_occluded, shadow_sections_culled);
+
+                p += snprintf(p, 8000 - (p-buf),
+                                "%d/%d/%d/%d chunks at 1x/2x/4x/8x\n",
+                                chunks_at_lod[0], chunks_at_lod[1], chunks_at_lod[2], chunks_at_lod[3]);
+
+                p += snprintf(p, 8000 - (p-buf),
+                                "%zu sun, %zu glow blocks waiting to spread, %dus/frame\n",
+                                light_queue_depth(&sunq), light_queue_depth(&gloq), light_budget_us);
+
+                p += snprintf(p, 8000 - (p-buf),
+                                "%.1fm of tiles\n", tile_bytes(NULL) / 1000000.f);
+
                 p += snprintf(p, 8000 - (p-buf),
                                 "%.1f fps\n", 1000.f * frames / elapsed );
 
+                p += snprintf(p, 8000 - (p-buf), "frame ms");
+                for (size_t i = 0; i < sizeof hist / sizeof *hist; i++)
+                {
+                        if (isinf(hist_ms[i]))
+                                p += snprintf(p, 8000 - (p-buf), " %.0f+:%d", hist_ms[i-1], hist[i]);
+                        else
+                                p += snprintf(p, 8000 - (p-buf), " <%.0f:%d", hist_ms[i], hist[i]);
+                        hist[i] = 0;
+                }
+                p += snprintf(p, 8000 - (p-buf), ", worst %.1f\n", worst_ms);
+                worst_ms = 0;
+
                 if (sunq_outta_room)
                         p += snprintf(p, 8000 - (p-buf),
                                         "Out of room in the sun queue (%d times)\n", sunq_outta_room);
                 sunq_outta_room = 0;
 
+                if (arena_outta_room)
+                        p += snprintf(p, 8000 - (p-buf),
+                                        "Out of room in the vertex arenas (%d times)\n", arena_outta_room);
+                arena_outta_room = 0;
+
                 if (gloq_outta_room)
                         p += snprintf(p, 8000 - (p-buf),
                                         "Out of room in the glo queue (%d times)\n", gloq_outta_room);
                 gloq_outta_room = 0;
 
+                if (save_failures)
+                        p += snprintf(p, 8000 - (p-buf),
+                                        "Could not save %d chunks\n", save_failures);
+
                 glGetIntegerv(0x9048, &total_kb);
                 glGetIntegerv(0x9049, &avail_kb);
                 last_ticks = ticks;
                 last_frame = frame;
                 polys = 0;
                 shadow_polys = 0;
+                meshes_uploaded = 0;
+                bytes_uploaded = 0;
+                most_bytes_uploaded = 0;
 
                 timer_print(timings_buf, 8000);
         }
@@ -113,14 +180,16 @@ void debrief()
         {
                 char xyzbuf[100];
                 snprintf(xyzbuf, 100,
-                                "X=%0.0f Y=%0.0f Z=%0.0f %svsync %sreg %smsaa %sfast %scull %slock",
+                                "X=%0.0f Y=%0.0f Z=%0.0f %svsync %sreg %smsaa %sfast %scull %socc %slod %slock",
                                 player[0].pos.x / BS, player[0].pos.y / BS, player[0].pos.z / BS,
-                                vsync           ? "" : "no",
-                                regulated       ? "" : "no",
-                                antialiasing    ? "" : "no",
-                                fast > 1        ? "" : "no",
-                                frustum_culling ? "" : "no",
-                                lock_culling    ? "" : "no");
+                                vsync             ? "" : "no",
+                                regulated         ? "" : "no",
+                                antialiasing      ? "" : "no",
+                                fast > 1          ? "" : "no",
+                                frustum_culling   ? "" : "no",
+                                occlusion_culling ? "" : "no",
+                                lod_meshing       ? "" : "no",
+                                lock_culling      ? "" : "no");
 
                 font_begin(screenw, screenh);
                 font_add_text(buf, 0, 0, 0);
@@ -146,8 +215,8 @@ void debrief()
 
         if (help_layer == 2)
         {
-                char *g1 = "Q     \nF   \nN       \nP       \nT       \nL         \nM             \nV    \nR             \n/   \nF1     \nF2          \nF3                    \nF4 ";
-                char *g2 = "Go up!\nFast\nRev. sun\nFast sun\nYest box\nLight vals\nShadow mapping\nVsync\nFixed interval\nMSAA\nCulling\nLock culling\nFPS, timings, position\nShow fresh updates";
+                char *g1 = "Q     \nF   \nN       \nP       \nT       \nL         \nM             \nV    \nR             \n/   \nF1     \nF2          \nF3                    \nF4                \nF6            \nF7            \nF8               \nF9             \nF10         ";
+                char *g2 = "Go up!\nFast\nRev. sun\nFast sun\nYest box\nLight vals\nShadow mapping\nVsync\nFixed interval\nMSAA\nCulling\nLock culling\nFPS, timings, position\nShow fresh updates\nGreedy meshing\nReload shaders\nOcclusion culling\nLevel of detail\nLight budget";
                 font_begin(screenw, screenh);
                 font_add_text(g1, screenw/100.f, screenh/4.f, 0);
                 font_end(0.5, 1, 1);
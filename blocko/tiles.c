@@ -0,0 +1,262 @@
+#include "blocko.h"
+
+// a section's tiles are kept as a block: all one tile, a palette of up to 16 tiles
+// with 1, 2 or 4 bit indices, or the plain tiles. Only plain blocks are written in
+// place -- writing anything else swaps in a plain copy first, see loosen_section().
+// compact_tiles() packs them up again once the writing is done. Readers don't lock,
+// so a replaced block is kept until every reader has since been idle, see
+// begin_tile_reads()
+int alloc_tiles()
+{
+        for (int i = 0; i < TILE_READERS; i++)
+                tile_readers[i] = TILE_IDLE;
+
+        for (int t = 0; t < 256; t++)
+        {
+                // + the index byte get_tile() reads, always 0
+                uniform_blocks[t] = calloc(1, sizeof **uniform_blocks + 1);
+                if (!uniform_blocks[t])
+                        return false;
+                uniform_blocks[t]->palette[0] = t;
+        }
+
+        for (size_t s = 0; s < VAOS * SECTIONS; s++)
+                tile_sections[s] = uniform_blocks[0];
+
+        return true;
+}
+
+// x and z are in memory, already scooted, see T_()
+unsigned char get_tile(unsigned x, unsigned y, unsigned z)
+{
+        struct tile_block *b = tile_sections[TSECT(x, y, z)];
+        unsigned i = TSECT_I(x, y, z);
+
+        if (b->bits == 8)
+                return b->data[i];
+
+        i *= b->bits;
+        return b->palette[(b->data[i / 8] >> (i % 8)) & ((1 << b->bits) - 1)];
+}
+
+// from mesh workers and chunk builders before each job: any block retired since
+// tile_epoch got here may still be read by this thread until end_tile_reads()
+void begin_tile_reads()
+{
+        tile_readers[omp_get_thread_num()] = tile_epoch;
+        #pragma omp flush // published before any tile_sections[] are read
+}
+
+void end_tile_reads()
+{
+        #pragma omp flush // done reading before letting go
+        tile_readers[omp_get_thread_num()] = TILE_IDLE;
+}
+
+// keep a replaced block around until no reader can still have it, see
+// free_retired_tiles(). Call inside omp critical (tile_sections)
+void retire_block(struct tile_block *b)
+{
+        if (!b->bits)
+                return; // uniform blocks are shared
+
+        if (retired_len == retired_room)
+        {
+                retired_room = retired_room ? retired_room * 2 : 1024;
+                retired_blocks = realloc(retired_blocks, retired_room * sizeof *retired_blocks);
+                if (!retired_blocks) exit(fprintf(stderr, "Out of memory for tiles\n"));
+        }
+
+        retired_blocks[retired_len++] = (struct retired_block){ b, tile_epoch };
+}
+
+// free the blocks retired before the oldest job still reading began, all of them if
+// no reader is in a job. A reader that began in a later epoch read tile_sections[]
+// after the block was swapped out, so it can't have it
+void free_retired_tiles()
+{
+        unsigned oldest = tile_epoch;
+        int busy = false;
+
+        #pragma omp flush // blocks swapped out before the readers are looked at
+        for (int i = 0; i < TILE_READERS; i++)
+        {
+                unsigned e = tile_readers[i];
+                if (e == TILE_IDLE)
+                        continue;
+                if (!busy || (int)(e - oldest) < 0)
+                        oldest = e;
+                busy = true;
+        }
+
+        #pragma omp critical (tile_sections)
+        {
+                size_t kept = 0;
+                for (size_t i = 0; i < retired_len; i++)
+                {
+                        if (!busy || (int)(oldest - retired_blocks[i].epoch) > 0)
+                                free(retired_blocks[i].b);
+                        else
+                                retired_blocks[kept++] = retired_blocks[i];
+                }
+                retired_len = kept;
+        }
+}
+
+// swap a packed section for a block of plain tiles that can be written in place,
+// returning it
+struct tile_block *loosen_section(size_t s)
+{
+        struct tile_block *b;
+
+        #pragma omp critical (tile_sections)
+        {
+                b = tile_sections[s];
+                if (b->bits != 8)
+                {
+                        struct tile_block *packed = b;
+                        b = malloc(sizeof *b + SECT_TILES);
+                        if (!b) exit(fprintf(stderr, "Out of memory for tiles\n"));
+
+                        b->bits = 8;
+                        for (unsigned i = 0; i < SECT_TILES; i++)
+                        {
+                                unsigned bit = i * packed->bits;
+                                b->data[i] = packed->palette[(packed->data[bit / 8] >> (bit % 8)) & ((1 << packed->bits) - 1)];
+                        }
+
+                        #pragma omp flush
+                        tile_sections[s] = b;
+                        retire_block(packed);
+                        tiles_loose[s / SECTIONS] = true;
+                }
+        }
+
+        return b;
+}
+
+void set_tile(unsigned x, unsigned y, unsigned z, unsigned char t)
+{
+        size_t s = TSECT(x, y, z);
+        struct tile_block *b = tile_sections[s];
+
+        if (b->bits != 8)
+        {
+                if (get_tile(x, y, z) == t)
+                        return;
+                b = loosen_section(s);
+        }
+
+        b->data[TSECT_I(x, y, z)] = t;
+}
+
+// pack a section of plain tiles into as few bits as it goes, nothing may be writing it
+void compact_section(size_t s)
+{
+        struct tile_block *b = tile_sections[s];
+        if (b->bits != 8)
+                return;
+
+        unsigned char index[256] = { 0 }; // palette index + 1, 0 if not in it yet
+        unsigned char palette[16];
+        int n = 0;
+
+        for (unsigned i = 0; i < SECT_TILES; i++)
+        {
+                unsigned char t = b->data[i];
+                if (index[t])
+                        continue;
+                if (n == 16)
+                        return; // too many to pack, stays plain
+                palette[n] = t;
+                index[t] = ++n;
+        }
+
+        struct tile_block *packed;
+        if (n == 1)
+        {
+                packed = uniform_blocks[palette[0]];
+        }
+        else
+        {
+                int bits = n <= 2 ? 1 : n <= 4 ? 2 : 4;
+                packed = calloc(1, sizeof *packed + SECT_TILES * bits / 8);
+                if (!packed) exit(fprintf(stderr, "Out of memory for tiles\n"));
+
+                packed->bits = bits;
+                memcpy(packed->palette, palette, n);
+                for (unsigned i = 0; i < SECT_TILES; i++)
+                {
+                        unsigned bit = i * bits;
+                        packed->data[bit / 8] |= (index[b->data[i]] - 1) << (bit % 8);
+                }
+        }
+
+        #pragma omp flush
+        #pragma omp critical (tile_sections)
+        {
+                tile_sections[s] = packed;
+                retire_block(b);
+        }
+}
+
+// from the main thread once a frame: pack up to max_chunks chunks that were written
+// as plain tiles, leaving any a chunk builder could still be writing, and free the
+// blocks no reader can still have. Returns how many chunks were packed
+int compact_tiles(int max_chunks)
+{
+        static int next_chunk; // round robin, so no chunk waits forever
+        int first = next_chunk;
+        int packed = 0;
+
+        tile_epoch++;
+
+        // chunk builders write one chunk out into their neighbors, and none start
+        // while this is held
+        SDL_LockMutex(chunk_queue_lock);
+        for (int i = 0; i < VAOS && packed < max_chunks; i++)
+        {
+                int c = (first + i) % VAOS;
+                if (!tiles_loose[c])
+                        continue;
+
+                int cx = c % VAOW;
+                int cz = c / VAOW;
+                int busy = false;
+                for (int dx = -1; dx <= 1; dx++) for (int dz = -1; dz <= 1; dz++)
+                        busy |= chunk_in_progress[(cz + dz) & (VAOD-1)][(cx + dx) & (VAOW-1)];
+                if (busy)
+                        continue;
+
+                tiles_loose[c] = false;
+                for (int s = 0; s < SECTIONS; s++)
+                        compact_section(c * SECTIONS + s);
+                packed++;
+                next_chunk = (c + 1) % VAOS;
+        }
+        SDL_UnlockMutex(chunk_queue_lock);
+
+        free_retired_tiles();
+        return packed;
+}
+
+// bytes of tile storage, counting up how many sections have each bits per tile in
+// counts[bits] if given
+size_t tile_bytes(size_t *counts)
+{
+        size_t bytes = sizeof tile_sections + 256 * (sizeof **uniform_blocks + 1);
+
+        if (counts)
+                memset(counts, 0, 9 * sizeof *counts);
+
+        for (size_t s = 0; s < VAOS * SECTIONS; s++)
+        {
+                int bits = tile_sections[s]->bits;
+                if (bits)
+                        bytes += sizeof **tile_sections + SECT_TILES * bits / 8;
+                if (counts)
+                        counts[bits]++;
+        }
+
+        return bytes;
+}
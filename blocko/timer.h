@@ -23,16 +23,15 @@
         X(create_hmap), \
         X(update_world), \
         X(update_player), \
-        X(step_sunlight), \
+        X(step_light), \
+        X(compact_tiles), \
+        X(save_chunks), \
         X(step_sunlight_building), \
-        X(step_glolight), \
         X(step_glolight_building), \
-        X(recalc_corner_lighting), \
-        X(rings), \
-        X(drawstale), \
-        X(buildvbo), \
-        X(glBufferData), \
-        X(glDrawArrays), \
+        X(upload), \
+        X(culling), \
+        X(meshrequests), \
+        X(drawchunks), \
         X(swapwindow), \
         X(glsetup), \
         X(font_init), \
@@ -77,3 +76,44 @@ void timer_print(char *buf, size_t n)
                                         "%6.1f  %2.0f%%  %s\n", secs, pct, timernamesprint[i]);
         }
 }
+
+// finer grained timers for the stages of gen_chunk(), in SDL performance
+// counter units since a whole chunk only takes a few ms
+#define STAGE(name, then) {                                                     \
+        unsigned long long now = SDL_GetPerformanceCounter();                   \
+        add_stage_time(stage_ ## name, now - (then));                           \
+        (then) = now;                                                           \
+}
+
+#define STAGES \
+        X(column_noise), \
+        X(cave_collect), \
+        X(cave_carve), \
+        X(water_fixup), \
+        X(trees), \
+        X(light_init),
+
+enum stagenames {
+        #define X(x) stage_ ## x
+        STAGES
+        #undef X
+        stage_
+};
+
+char stagenamesprint[][80] = {
+        #define X(x) #x
+        STAGES
+        #undef X
+        "total"
+};
+
+#undef STAGES
+
+unsigned long long stage_times[stage_ + 1] = { 0 };
+
+// from STAGE(), on any of gen_chunk()'s threads
+void add_stage_time(int stage, unsigned long long t)
+{
+        #pragma omp atomic
+        stage_times[stage] += t;
+}
@@ -0,0 +1,186 @@
+#include "blocko.h"
+
+// first span of an arena with room for len points, making another arena if they're
+// all full, false if there can't be any more
+int arena_alloc(unsigned len, unsigned char *arena, unsigned *first)
+{
+        for (int a = 0; a < nr_arenas || (len <= ARENA_LEN && new_arena()); a++)
+        {
+                struct arena *r = arenas + a;
+
+                for (int i = 0; i < r->nr_free; i++)
+                {
+                        struct span *s = r->free + i;
+                        if (s->len < len)
+                                continue;
+
+                        *arena = a;
+                        *first = s->first;
+                        s->first += len;
+                        s->len -= len;
+                        if (!s->len)
+                                memmove(s, s + 1, (--r->nr_free - i) * sizeof *s);
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+// give points back to the arena, merging with the spans on either side
+void arena_free(int arena, unsigned first, unsigned len)
+{
+        struct arena *r = arenas + arena;
+        struct span *f = r->free;
+        int i = 0;
+
+        while (i < r->nr_free && f[i].first < first)
+                i++;
+
+        int before = (i > 0 && f[i-1].first + f[i-1].len == first);
+        int after = (i < r->nr_free && first + len == f[i].first);
+
+        if (before && after)
+        {
+                f[i-1].len += len + f[i].len;
+                memmove(f + i, f + i + 1, (--r->nr_free - i) * sizeof *f);
+        }
+        else if (before)
+        {
+                f[i-1].len += len;
+        }
+        else if (after)
+        {
+                f[i].first = first;
+                f[i].len += len;
+        }
+        else
+        {
+                memmove(f + i + 1, f + i, (r->nr_free++ - i) * sizeof *f);
+                f[i] = (struct span){ first, len };
+        }
+}
+
+// move on to the next section of the staging ring, waiting for the gpu to be
+// done copying out of it from RING_SECTIONS frames ago
+void ring_begin_frame()
+{
+        ring_section = (ring_section + 1) % RING_SECTIONS;
+        ring_used = 0;
+
+        GLsync *fence = ring_fences + ring_section;
+        if (*fence)
+        {
+                glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+                glDeleteSync(*fence);
+                *fence = 0;
+        }
+}
+
+void ring_end_frame()
+{
+        if (ring_used)
+                ring_fences[ring_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// copy a mesh into its section's span of an arena, making it a bigger span first if
+// need be, returns false if there's no more room in the ring this frame
+int upload_mesh(struct chunk_mesh *m)
+{
+        size_t bytes = m->len * sizeof *m->verts;
+        int s = m->slot;
+
+        if (use_buffer_storage && ring_used + bytes > RING_SECTION_SZ)
+                return false;
+
+        if (m->len > vbo_room[s])
+        {
+                if (vbo_room[s])
+                        arena_free(vbo_arena[s], vbo_first[s], vbo_room[s]);
+
+                // leave some room to grow, so small changes stay in place
+                vbo_room[s] = (m->len + m->len / 4 + 63) & ~63u;
+                if (!arena_alloc(vbo_room[s], vbo_arena + s, vbo_first + s))
+                {
+                        // the section won't be drawn, so say so where it can't be missed
+                        if (!arena_outta_room++)
+                                fprintf(stderr, "Out of room for meshes in %d arenas\n", nr_arenas);
+                        snprintf(alert, sizeof alert, "Out of room for meshes, some of the world isn't drawn");
+                        vbo_room[s] = 0;
+                        vbo_len[s] = 0;
+                        return true;
+                }
+        }
+
+        unsigned int vbo = arenas[vbo_arena[s]].vbo;
+        size_t offset = vbo_first[s] * sizeof *m->verts;
+
+        if (use_buffer_storage)
+        {
+                memcpy(ring_map + ring_section * RING_SECTION_SZ + ring_used, m->verts, bytes);
+                glBindBuffer(GL_COPY_READ_BUFFER, ring_vbo);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                ring_section * RING_SECTION_SZ + ring_used, offset, bytes);
+                ring_used += bytes;
+        }
+        else
+        {
+                glBindBuffer(GL_ARRAY_BUFFER, vbo);
+                glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, m->verts);
+        }
+
+        vbo_len[s] = m->len;
+        section_bounds[s] = m->bounds;
+        bytes_uploaded += bytes;
+        return true;
+}
+
+// ship the meshes the mesh workers have finished off to gl, listing the sections
+// updated in shipped (x, y is the section, z), returns how many
+size_t upload_meshes(struct qitem *shipped)
+{
+        size_t shipped_len = 0;
+        size_t bytes_before = bytes_uploaded;
+        struct chunk_mesh *m = take_ready_meshes();
+
+        if (use_buffer_storage)
+                ring_begin_frame();
+
+        while (m)
+        {
+                struct chunk_mesh *next = m->next;
+
+                if (m->scootx != chunk_scootx || m->scootz != chunk_scootz)
+                {
+                        chunk_dirty[m->slot] = true; // the map moved since, try again
+                }
+                else if (m->gen != mesh_job_gen[m->slot])
+                {
+                        // queued again since, so a newer mesh is coming or already went up
+                }
+                else if (!upload_mesh(m))
+                {
+                        break; // the rest wait for next frame
+                }
+                else
+                {
+                        meshes_uploaded++;
+                        if (shipped_len < VAOS * SECTIONS)
+                                shipped[shipped_len++] = (struct qitem){ m->x, m->sy, m->z };
+                }
+
+                free(m);
+                m = next;
+        }
+
+        return_ready_meshes(m);
+
+        if (use_buffer_storage)
+                ring_end_frame();
+
+        if (bytes_uploaded - bytes_before > most_bytes_uploaded)
+                most_bytes_uploaded = bytes_uploaded - bytes_before;
+
+        return shipped_len;
+}